@@ -1,18 +1,641 @@
 #include "apu.h"
-#include <iostream>
+#include "memory.h"
+#include <algorithm>
+
+// CPU cycles from the start of a frame counter sequence to each step (NTSC)
+static const uint32_t FRAME_STEP_CYCLES[2][4] = {
+	{ 7457, 14913, 22371, 29829 }, // 4-step
+	{ 7457, 14913, 22371, 37281 }  // 5-step
+};
+static const uint32_t FRAME_PERIOD[2] = { 29830, 37282 };
+
+static const uint8_t LENGTH_TABLE[32] = {
+	10, 254, 20, 2, 40, 4, 80, 6, 160, 8, 60, 10, 14, 12, 26, 14,
+	12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30
+};
+
+// Output of the 8 sequencer steps for each duty cycle, first step in bit 7
+static const uint8_t DUTY_TABLE[4] = { 0x40, 0x60, 0x78, 0x9F };
+
+// Periods in CPU cycles (NTSC)
+static const uint16_t NOISE_PERIODS[16] = {
+	4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068
+};
+static const uint16_t DMC_RATES[16] = {
+	428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54
+};
+
+// The mixer is nonlinear, so it's two lookups: both pulses summed, then
+// 3 * triangle + 2 * noise + DMC
+static constexpr std::array<float, 31> makePulseTable()
+{
+	std::array<float, 31> table = {};
+	for (int i = 1; i < 31; i++)
+		table[i] = static_cast<float>(95.52 / (8128.0 / i + 100));
+	return table;
+}
+
+static constexpr std::array<float, 203> makeTNDTable()
+{
+	std::array<float, 203> table = {};
+	for (int i = 1; i < 203; i++)
+		table[i] = static_cast<float>(163.67 / (24329.0 / i + 100));
+	return table;
+}
+
+static constexpr auto PULSE_TABLE = makePulseTable();
+static constexpr auto TND_TABLE = makeTNDTable();
+
 APU::APU()
 {
-	std::fill(std::begin(registers), std::end(registers), 0);
+	dmcIRQ = false;
+	channels = 0;
+	scheduler = nullptr;
+	sequenceStart = 0;
+	frameStep = 0;
+	fiveStepMode = false;
+	irqInhibit = false;
+	frameIRQ = false;
+	memory = nullptr;
+	syncedCycles = 0;
+}
+
+void APU::setScheduler(Scheduler* scheduler)
+{
+	this->scheduler = scheduler;
+	syncedCycles = scheduler->now();
+	scheduler->setHandler(EventType::APUFrameCounter, [this]() { clockFrameCounter(); });
+	scheduler->setHandler(EventType::DMCIRQ, [this]() { catchUp(); scheduleDMCIRQ(); });
+	restartFrameCounter();
+}
+
+void APU::setAudioSink(AudioSink* sink)
+{
+	this->sink = sink;
+	lastPulseLevel = lastTNDLevel = 0xFF;
+	mix();
+}
+
+void APU::Envelope::serialize(StateStream& state)
+{
+	state(start);
+	state(loop);
+	state(constant);
+	state(volume);
+	state(divider);
+	state(decay);
+}
+
+void APU::Pulse::serialize(StateStream& state)
+{
+	envelope.serialize(state);
+	state(duty);
+	state(sequence);
+	state(period);
+	state(timer);
+	state(length);
+	state(sweepEnabled);
+	state(sweepNegate);
+	state(sweepReload);
+	state(sweepPeriod);
+	state(sweepShift);
+	state(sweepDivider);
+}
+
+void APU::Triangle::serialize(StateStream& state)
+{
+	state(control);
+	state(linearReload);
+	state(linearPeriod);
+	state(linear);
+	state(sequence);
+	state(period);
+	state(timer);
+	state(length);
+}
+
+void APU::Noise::serialize(StateStream& state)
+{
+	envelope.serialize(state);
+	state(mode);
+	state(shift);
+	state(period);
+	state(timer);
+	state(length);
+}
+
+void APU::DMC::serialize(StateStream& state)
+{
+	state(irqEnabled);
+	state(loop);
+	state(rate);
+	state(timer);
+	state(level);
+	state(sampleAddress);
+	state(sampleLength);
+	state(address);
+	state(remaining);
+	state(buffer);
+	state(bufferFull);
+	state(shift);
+	state(bits);
+	state(silence);
+}
+
+// The frame counter's next step and the DMC IRQ are scheduler events and
+// are saved with it
+void APU::serialize(StateStream& state)
+{
+	pulse[0].serialize(state);
+	pulse[1].serialize(state);
+	triangle.serialize(state);
+	noise.serialize(state);
+	dmc.serialize(state);
+	state(dmcIRQ);
+	state(channels);
+
+	state(sequenceStart);
+	state(frameStep);
+	state(fiveStepMode);
+	state(irqInhibit);
+	state(frameIRQ);
+	state(syncedCycles);
+
+	// The sink hears the loaded output at the next change
+	if (state.isLoading())
+		lastPulseLevel = lastTNDLevel = 0xFF;
+}
+
+void APU::catchUp()
+{
+	if (scheduler)
+		run(scheduler->now());
+}
+
+// Counts down a channel timer by cycles, reloading it with period each
+// time it expires, and returns how many times it did
+static uint64_t advanceTimer(uint32_t& timer, uint32_t period, uint64_t cycles)
+{
+	if (cycles < timer)
+	{
+		timer -= static_cast<uint32_t>(cycles);
+		return 0;
+	}
+
+	cycles -= timer;
+	timer = period - static_cast<uint32_t>(cycles % period);
+	return 1 + cycles / period;
+}
+
+// Jumps straight to the next time a channel's output can change. Channels
+// that can't be heard over the whole stretch (nothing in here changes
+// that, it takes a register write or a frame counter step) have their
+// timers moved forward in one go instead
+void APU::run(uint64_t target)
+{
+	bool pulseAudible[2];
+	for (int i = 0; i < 2; i++)
+		pulseAudible[i] = pulse[i].length > 0 && !pulse[i].muted(i == 0) && pulse[i].envelope.output() > 0;
+	bool triangleStepping = triangle.running() && triangle.linear > 0 && triangle.length > 0;
+	bool noiseAudible = noise.length > 0 && noise.envelope.output() > 0;
+
+	while (syncedCycles < target)
+	{
+		// An idle DMC only counts out empty output cycles
+		bool dmcActive = !dmc.silence || dmc.bufferFull;
+
+		uint64_t step = target - syncedCycles;
+		for (int i = 0; i < 2; i++)
+		{
+			if (pulseAudible[i])
+				step = std::min<uint64_t>(step, pulse[i].timer);
+		}
+		if (triangleStepping)
+			step = std::min<uint64_t>(step, triangle.timer);
+		if (noiseAudible)
+			step = std::min<uint64_t>(step, noise.timer);
+		if (dmcActive)
+			step = std::min<uint64_t>(step, dmc.timer);
+		syncedCycles += step;
+
+		for (Pulse& channel : pulse)
+		{
+			uint64_t steps = advanceTimer(channel.timer, (channel.period + 1) * 2, step);
+			channel.sequence = (channel.sequence + steps) & 0x07;
+		}
+
+		if (triangle.running())
+		{
+			uint64_t steps = advanceTimer(triangle.timer, triangle.period + 1, step);
+			if (triangleStepping)
+				triangle.sequence = (triangle.sequence + steps) & 0x1F;
+		}
+
+		// The shift register is held while the channel is silent
+		if (advanceTimer(noise.timer, noise.period, step) && noiseAudible)
+		{
+			uint16_t feedback = (noise.shift ^ (noise.shift >> (noise.mode ? 6 : 1))) & 0x01;
+			noise.shift = (noise.shift >> 1) | (feedback << 14);
+		}
+
+		uint64_t dmcSteps = advanceTimer(dmc.timer, dmc.rate, step);
+		if (dmcActive && dmcSteps)
+		{
+			clockDMC();
+		}
+		else if (dmcSteps)
+		{
+			dmc.bits = static_cast<uint8_t>((dmc.bits + 7 - dmcSteps % 8) % 8 + 1);
+			dmc.shift = dmcSteps >= 8 ? 0 : dmc.shift >> dmcSteps;
+		}
+
+		mix();
+	}
+}
+
+void APU::mix()
+{
+	if (!sink)
+		return;
+
+	uint8_t pulseLevel = pulse[0].output(true) + pulse[1].output(false);
+	uint8_t tndLevel = 3 * triangle.output() + 2 * noise.output() + dmc.level;
+	if (pulseLevel != lastPulseLevel || tndLevel != lastTNDLevel)
+	{
+		lastPulseLevel = pulseLevel;
+		lastTNDLevel = tndLevel;
+		sink->outputChanged(syncedCycles, PULSE_TABLE[pulseLevel] + TND_TABLE[tndLevel]);
+	}
+}
+
+void APU::Envelope::clock()
+{
+	if (start)
+	{
+		start = false;
+		decay = 15;
+		divider = volume;
+	}
+	else if (divider == 0)
+	{
+		divider = volume;
+		if (decay > 0)
+			decay--;
+		else if (loop)
+			decay = 15;
+	}
+	else
+	{
+		divider--;
+	}
+}
+
+// Pulse 1 negates with ones' complement, pulse 2 with two's
+uint16_t APU::Pulse::sweepTarget(bool onesComplement) const
+{
+	int change = period >> sweepShift;
+	if (sweepNegate)
+		return static_cast<uint16_t>(std::max(0, period - change - (onesComplement ? 1 : 0)));
+	return static_cast<uint16_t>(period + change);
+}
+
+// Muting doesn't depend on the sweep being enabled
+bool APU::Pulse::muted(bool onesComplement) const
+{
+	return period < 8 || sweepTarget(onesComplement) > 0x7FF;
+}
+
+void APU::Pulse::clockSweep(bool onesComplement)
+{
+	if (sweepDivider == 0 && sweepEnabled && sweepShift > 0 && !muted(onesComplement))
+		period = sweepTarget(onesComplement);
+
+	if (sweepDivider == 0 || sweepReload)
+	{
+		sweepDivider = sweepPeriod;
+		sweepReload = false;
+	}
+	else
+	{
+		sweepDivider--;
+	}
+}
+
+uint8_t APU::Pulse::output(bool onesComplement) const
+{
+	if (length == 0 || muted(onesComplement) || !((DUTY_TABLE[duty] >> (7 - sequence)) & 0x01))
+		return 0;
+	return envelope.output();
+}
+
+void APU::clockDMC()
+{
+	if (!dmc.silence)
+	{
+		if (dmc.shift & 0x01)
+		{
+			if (dmc.level <= 125)
+				dmc.level += 2;
+		}
+		else if (dmc.level >= 2)
+		{
+			dmc.level -= 2;
+		}
+	}
+	dmc.shift >>= 1;
+
+	if (--dmc.bits == 0)
+	{
+		dmc.bits = 8;
+		dmc.silence = !dmc.bufferFull;
+		if (dmc.bufferFull)
+		{
+			dmc.shift = dmc.buffer;
+			dmc.bufferFull = false;
+			fetchDMCSample();
+		}
+	}
+}
+
+// The reader refills the sample buffer as soon as it empties. Cycles the
+// CPU is stalled for the fetch aren't modelled
+void APU::fetchDMCSample()
+{
+	if (dmc.bufferFull || dmc.remaining == 0)
+		return;
+
+	dmc.buffer = memory ? memory->read(dmc.address) : 0;
+	dmc.bufferFull = true;
+	dmc.address = dmc.address == 0xFFFF ? 0x8000 : dmc.address + 1;
+
+	if (--dmc.remaining == 0)
+	{
+		if (dmc.loop)
+		{
+			restartDMC();
+		}
+		else if (dmc.irqEnabled)
+		{
+			dmcIRQ = true;
+			scheduler->raiseIRQ(IRQSource::DMC);
+		}
+	}
+}
+
+void APU::restartDMC()
+{
+	dmc.address = dmc.sampleAddress;
+	dmc.remaining = dmc.sampleLength;
+}
+
+// The APU only runs when caught up, so the fetch that ends a sample gets
+// an event of its own for the IRQ to be seen on time. With the buffer
+// full, the next fetch comes when the current output cycle ends and the
+// rest follow every 8 bits
+void APU::scheduleDMCIRQ()
+{
+	if (!scheduler)
+		return;
+
+	if (!dmc.irqEnabled || dmc.loop || dmc.remaining == 0 || !dmc.bufferFull)
+	{
+		scheduler->cancel(EventType::DMCIRQ);
+		return;
+	}
+
+	uint64_t cycles = dmc.timer + static_cast<uint64_t>(dmc.bits - 1) * dmc.rate
+		+ static_cast<uint64_t>(dmc.remaining - 1) * 8 * dmc.rate;
+	scheduler->schedule(EventType::DMCIRQ, syncedCycles + cycles);
+}
+
+void APU::restartFrameCounter()
+{
+	if (!scheduler)
+		return;
+
+	sequenceStart = scheduler->now();
+	frameStep = 0;
+	scheduler->schedule(EventType::APUFrameCounter, sequenceStart + FRAME_STEP_CYCLES[fiveStepMode][0]);
+}
+
+void APU::clockQuarterFrame()
+{
+	pulse[0].envelope.clock();
+	pulse[1].envelope.clock();
+	noise.envelope.clock();
+
+	if (triangle.linearReload)
+		triangle.linear = triangle.linearPeriod;
+	else if (triangle.linear > 0)
+		triangle.linear--;
+	if (!triangle.control)
+		triangle.linearReload = false;
+}
+
+void APU::clockHalfFrame()
+{
+	for (Pulse& channel : pulse)
+	{
+		if (!channel.envelope.loop && channel.length > 0)
+			channel.length--;
+	}
+	if (!triangle.control && triangle.length > 0)
+		triangle.length--;
+	if (!noise.envelope.loop && noise.length > 0)
+		noise.length--;
+
+	pulse[0].clockSweep(true);
+	pulse[1].clockSweep(false);
+}
+
+// Every step clocks envelopes and the triangle's linear counter, the
+// second and last also length counters and sweeps
+void APU::clockFrameCounter()
+{
+	catchUp();
+
+	clockQuarterFrame();
+	if (frameStep == 1 || frameStep == 3)
+		clockHalfFrame();
+	mix();
+
+	if (!fiveStepMode && frameStep == 3 && !irqInhibit)
+	{
+		frameIRQ = true;
+		scheduler->raiseIRQ(IRQSource::APUFrame);
+	}
+
+	if (++frameStep == 4)
+	{
+		frameStep = 0;
+		sequenceStart += FRAME_PERIOD[fiveStepMode];
+	}
+	scheduler->schedule(EventType::APUFrameCounter, sequenceStart + FRAME_STEP_CYCLES[fiveStepMode][frameStep]);
 }
 
 void APU::writeRegister(uint16_t addr, uint8_t value)
 {
-	//std::cout << "APU Write to address: " << std::hex << addr << " with data: " << std::hex << (int)value << std::endl;
-	registers[addr - 0x4000] = value;
+	catchUp();
+
+	switch (addr)
+	{
+	case 0x4000:
+	case 0x4004:
+	{
+		Pulse& channel = pulse[(addr >> 2) & 0x01];
+		channel.duty = value >> 6;
+		channel.envelope.loop = value & 0x20;
+		channel.envelope.constant = value & 0x10;
+		channel.envelope.volume = value & 0x0F;
+		break;
+	}
+	case 0x4001:
+	case 0x4005:
+	{
+		Pulse& channel = pulse[(addr >> 2) & 0x01];
+		channel.sweepEnabled = value & 0x80;
+		channel.sweepPeriod = (value >> 4) & 0x07;
+		channel.sweepNegate = value & 0x08;
+		channel.sweepShift = value & 0x07;
+		channel.sweepReload = true;
+		break;
+	}
+	case 0x4002:
+	case 0x4006:
+	{
+		Pulse& channel = pulse[(addr >> 2) & 0x01];
+		channel.period = (channel.period & 0x0700) | value;
+		break;
+	}
+	case 0x4003:
+	case 0x4007:
+	{
+		int index = (addr >> 2) & 0x01;
+		Pulse& channel = pulse[index];
+		channel.period = (channel.period & 0x00FF) | ((value & 0x07) << 8);
+		if (channels & (1 << index))
+			channel.length = LENGTH_TABLE[value >> 3];
+		channel.sequence = 0;
+		channel.envelope.start = true;
+		break;
+	}
+	case 0x4008:
+		triangle.control = value & 0x80;
+		triangle.linearPeriod = value & 0x7F;
+		break;
+	case 0x400A:
+		triangle.period = (triangle.period & 0x0700) | value;
+		break;
+	case 0x400B:
+		triangle.period = (triangle.period & 0x00FF) | ((value & 0x07) << 8);
+		if (channels & 0x04)
+			triangle.length = LENGTH_TABLE[value >> 3];
+		triangle.linearReload = true;
+		break;
+	case 0x400C:
+		noise.envelope.loop = value & 0x20;
+		noise.envelope.constant = value & 0x10;
+		noise.envelope.volume = value & 0x0F;
+		break;
+	case 0x400E:
+		noise.mode = value & 0x80;
+		noise.period = NOISE_PERIODS[value & 0x0F];
+		break;
+	case 0x400F:
+		if (channels & 0x08)
+			noise.length = LENGTH_TABLE[value >> 3];
+		noise.envelope.start = true;
+		break;
+	case 0x4010:
+		dmc.irqEnabled = value & 0x80;
+		dmc.loop = value & 0x40;
+		dmc.rate = DMC_RATES[value & 0x0F];
+		if (!dmc.irqEnabled && scheduler)
+		{
+			dmcIRQ = false;
+			scheduler->clearIRQ(IRQSource::DMC);
+		}
+		break;
+	case 0x4011:
+		dmc.level = value & 0x7F;
+		break;
+	case 0x4012:
+		dmc.sampleAddress = 0xC000 | (value << 6);
+		break;
+	case 0x4013:
+		dmc.sampleLength = (value << 4) | 0x01;
+		break;
+	case 0x4015:
+		channels = value & 0x1F;
+		if (!(channels & 0x01))
+			pulse[0].length = 0;
+		if (!(channels & 0x02))
+			pulse[1].length = 0;
+		if (!(channels & 0x04))
+			triangle.length = 0;
+		if (!(channels & 0x08))
+			noise.length = 0;
+
+		if (!(channels & 0x10))
+		{
+			dmc.remaining = 0;
+		}
+		else if (dmc.remaining == 0)
+		{
+			restartDMC();
+			fetchDMCSample();
+		}
+
+		dmcIRQ = false;
+		if (scheduler)
+			scheduler->clearIRQ(IRQSource::DMC);
+		break;
+	case 0x4017:
+		fiveStepMode = value & 0x80;
+		irqInhibit = value & 0x40;
+		if (irqInhibit && scheduler)
+		{
+			frameIRQ = false;
+			scheduler->clearIRQ(IRQSource::APUFrame);
+		}
+		restartFrameCounter();
+
+		// The 5-step sequence clocks everything as it starts
+		if (fiveStepMode)
+		{
+			clockQuarterFrame();
+			clockHalfFrame();
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (addr >= 0x4010 && addr <= 0x4015)
+		scheduleDMCIRQ();
+	mix();
 }
 
 uint8_t APU::readRegister(uint16_t addr)
 {
-	//std::cout << "APU Read from address: " << std::hex << addr << std::endl;
-	return registers[addr - 0x4000];
+	if (addr != 0x4015)
+	{
+		return 0; // Write-only
+	}
+
+	catchUp();
+
+	uint8_t status = (pulse[0].length > 0 ? 0x01 : 0x00)
+		| (pulse[1].length > 0 ? 0x02 : 0x00)
+		| (triangle.length > 0 ? 0x04 : 0x00)
+		| (noise.length > 0 ? 0x08 : 0x00)
+		| (dmc.remaining > 0 ? 0x10 : 0x00)
+		| (frameIRQ ? 0x40 : 0x00)
+		| (dmcIRQ ? 0x80 : 0x00);
+
+	// Reading status acknowledges the frame interrupt
+	frameIRQ = false;
+	if (scheduler)
+		scheduler->clearIRQ(IRQSource::APUFrame);
+	return status;
 }
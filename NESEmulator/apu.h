@@ -1,13 +1,164 @@
 #pragma once
 #include <cstdint>
 #include <array>
+#include "scheduler.h"
+#include "savestate.h"
+
+class Memory;
+
+// Gets the mixed output, 0 to about 1, each time it changes, timed in CPU
+// cycles. The APU only runs when something catches it up, so calls come
+// in bursts that trail the CPU by up to a frame counter step
+class AudioSink
+{
+public:
+	virtual ~AudioSink() = default;
+	virtual void outputChanged(uint64_t cycle, float level) = 0;
+};
+
+// 2A03 sound: two pulses, triangle, noise and DMC plus the frame counter.
+// Like the PPU it runs on demand: register accesses and scheduler events
+// first catch it up to the CPU's cycle count, and in between it jumps
+// from one channel timer expiring to the next instead of ticking every
+// cycle, so its cost follows what the channels do rather than the clock
 class APU
 {
 private:
-	std::array<uint8_t, 24> registers;
+	struct Envelope
+	{
+		bool start = false;
+		bool loop = false;     // Also halts the channel's length counter
+		bool constant = false;
+		uint8_t volume = 0;    // Constant volume, or the decay period
+		uint8_t divider = 0;
+		uint8_t decay = 0;
+
+		void clock();
+		uint8_t output() const { return constant ? volume : decay; }
+		void serialize(StateStream& state);
+	};
+
+	struct Pulse
+	{
+		Envelope envelope;
+		uint8_t duty = 0;
+		uint8_t sequence = 0;
+		uint16_t period = 0;   // 11-bit timer reload
+		uint32_t timer = 2;    // CPU cycles to the next sequencer step
+		uint8_t length = 0;
+
+		bool sweepEnabled = false;
+		bool sweepNegate = false;
+		bool sweepReload = false;
+		uint8_t sweepPeriod = 0;
+		uint8_t sweepShift = 0;
+		uint8_t sweepDivider = 0;
+
+		uint16_t sweepTarget(bool onesComplement) const;
+		bool muted(bool onesComplement) const;
+		void clockSweep(bool onesComplement);
+		uint8_t output(bool onesComplement) const;
+		void serialize(StateStream& state);
+	};
+
+	struct Triangle
+	{
+		bool control = false;  // Also halts the length counter
+		bool linearReload = false;
+		uint8_t linearPeriod = 0;
+		uint8_t linear = 0;
+		uint8_t sequence = 0;
+		uint16_t period = 0;
+		uint32_t timer = 1;
+		uint8_t length = 0;
+
+		// Periods below 2 are ultrasonic; the sequencer is held instead of
+		// stepping every CPU cycle
+		bool running() const { return period >= 2; }
+		uint8_t output() const { return sequence < 16 ? 15 - sequence : sequence - 16; }
+		void serialize(StateStream& state);
+	};
+
+	struct Noise
+	{
+		Envelope envelope;
+		bool mode = false;
+		uint16_t shift = 1;
+		uint16_t period = 4;   // In CPU cycles
+		uint32_t timer = 4;
+		uint8_t length = 0;
+
+		uint8_t output() const { return (shift & 0x01) || length == 0 ? 0 : envelope.output(); }
+		void serialize(StateStream& state);
+	};
+
+	struct DMC
+	{
+		bool irqEnabled = false;
+		bool loop = false;
+		uint16_t rate = 428;   // CPU cycles per output bit
+		uint32_t timer = 428;
+		uint8_t level = 0;
+
+		uint16_t sampleAddress = 0xC000;
+		uint16_t sampleLength = 1;
+		uint16_t address = 0xC000;
+		uint16_t remaining = 0; // Bytes left to fetch
+
+		uint8_t buffer = 0;
+		bool bufferFull = false;
+		uint8_t shift = 0;
+		uint8_t bits = 8;       // Left in the current output cycle
+		bool silence = true;
+
+		void serialize(StateStream& state);
+	};
+
+	Pulse pulse[2];
+	Triangle triangle;
+	Noise noise;
+	DMC dmc;
+	bool dmcIRQ;
+	uint8_t channels; // $4015 enable bits
+
+	// Frame counter ($4017)
+	Scheduler* scheduler;
+	uint64_t sequenceStart;
+	uint8_t frameStep;
+	bool fiveStepMode;
+	bool irqInhibit;
+	bool frameIRQ;
+
+	Memory* memory;        // DMC sample fetches
+	uint64_t syncedCycles; // CPU cycle the channels have run up to
+
+	AudioSink* sink = nullptr;
+	uint8_t lastPulseLevel = 0xFF; // Mixer inputs last sent to the sink
+	uint8_t lastTNDLevel = 0xFF;
+
+	void restartFrameCounter();
+	void clockFrameCounter();
+	void clockQuarterFrame();
+	void clockHalfFrame();
+
+	void run(uint64_t target);
+	void clockDMC();
+	void fetchDMCSample();
+	void restartDMC();
+	void scheduleDMCIRQ();
+	void mix();
+
 public:
 	APU();
+	void setScheduler(Scheduler* scheduler);
+	void setMemory(Memory* memory) { this->memory = memory; }
+	void setAudioSink(AudioSink* sink);
+
+	// Runs the channels up to the CPU's current cycle
+	void catchUp();
+
 	void writeRegister(uint16_t addr, uint8_t value);
 	uint8_t readRegister(uint16_t addr);
-};
 
+	void serialize(StateStream& state);
+};
@@ -0,0 +1,108 @@
+#include "blep.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+static const double Pi = 3.14159265358979323846;
+
+// Windowed sinc impulses for each phase, cut off a little under the
+// output Nyquist rate. The buffer holds differences, so adding one of
+// these makes a smooth step once integrated
+template<int Phases, int Width>
+static std::array<std::array<float, Width>, Phases> makeKernels()
+{
+	const double cutoff = 0.45; // Of the sample rate
+	std::array<std::array<float, Width>, Phases> kernels;
+
+	for (int phase = 0; phase < Phases; phase++)
+	{
+		double taps[Width];
+		double total = 0;
+		for (int i = 0; i < Width; i++)
+		{
+			// Centred between taps Width / 2 - 1 and Width / 2
+			double x = i - (Width / 2 - 1) - static_cast<double>(phase) / Phases;
+			double sinc = x == 0 ? 1 : std::sin(2 * Pi * cutoff * x) / (2 * Pi * cutoff * x);
+			double window = 0.42 + 0.5 * std::cos(Pi * x / (Width / 2)) + 0.08 * std::cos(2 * Pi * x / (Width / 2));
+			taps[i] = sinc * window;
+			total += taps[i];
+		}
+
+		// Whatever the phase, a step ends up exactly its height
+		for (int i = 0; i < Width; i++)
+			kernels[phase][i] = static_cast<float>(taps[i] / total);
+	}
+	return kernels;
+}
+
+const std::array<std::array<float, BlepSynth::Width>, BlepSynth::Phases> BlepSynth::kernels = makeKernels<Phases, Width>();
+
+BlepSynth::BlepSynth(double clockRate, int sampleRate) : clockRate(clockRate)
+{
+	setRate(sampleRate);
+
+	// A tenth of a second, many frames' worth
+	buffer.resize(sampleRate / 10 + Width);
+
+	const double highPassHz = 90;
+	highPassFactor = static_cast<float>(std::exp(-2 * Pi * highPassHz / sampleRate));
+}
+
+void BlepSynth::setRate(double sampleRate)
+{
+	factor = static_cast<uint64_t>(sampleRate / clockRate * (1ull << TimeBits) + 0.5);
+}
+
+void BlepSynth::outputChanged(uint64_t cycle, float level)
+{
+	float delta = level - this->level;
+	this->level = level;
+
+	uint64_t position = offset + (cycle > baseCycle ? cycle - baseCycle : 0) * factor;
+	size_t index = static_cast<size_t>(position >> TimeBits);
+	if (index + Width > buffer.size())
+	{
+		return; // Nobody is reading, the sample would be dropped anyway
+	}
+
+	const auto& kernel = kernels[(position >> (TimeBits - PhaseBits)) & (Phases - 1)];
+	float* out = &buffer[index];
+	for (int i = 0; i < Width; i++)
+		out[i] += kernel[i] * delta;
+}
+
+void BlepSynth::endFrame(uint64_t cycle)
+{
+	if (cycle > baseCycle)
+	{
+		offset += (cycle - baseCycle) * factor;
+		baseCycle = cycle;
+	}
+
+	// Keep the unread samples within the buffer, time runs on regardless
+	uint64_t limit = static_cast<uint64_t>(buffer.size() - Width) << TimeBits;
+	offset = std::min(offset, limit);
+}
+
+size_t BlepSynth::readSamples(int16_t* out, size_t count)
+{
+	count = std::min(count, samplesAvailable());
+
+	for (size_t i = 0; i < count; i++)
+	{
+		sum += buffer[i];
+		highPass = highPassFactor * highPass + sum - lastSum;
+		lastSum = sum;
+
+		float sample = highPass * 24000.0f;
+		out[i] = static_cast<int16_t>(std::clamp(sample, -32768.0f, 32767.0f));
+	}
+
+	// Move the unfinished tail to the front
+	size_t remaining = buffer.size() - count;
+	std::memmove(buffer.data(), buffer.data() + count, remaining * sizeof(float));
+	std::fill(buffer.begin() + remaining, buffer.end(), 0.0f);
+	offset -= static_cast<uint64_t>(count) << TimeBits;
+	return count;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "apu.h"
+
+// Turns the APU's timestamped output changes into samples at the output
+// rate. Every change adds a band-limited step, a windowed sinc at the
+// change's sub-sample position, to a buffer of differences that is
+// integrated on the way out. Nothing runs per CPU cycle, and edges far
+// above the output Nyquist rate come out smooth instead of aliasing
+class BlepSynth : public AudioSink
+{
+public:
+	BlepSynth(double clockRate, int sampleRate);
+
+	void outputChanged(uint64_t cycle, float level) override;
+
+	// Every change before cycle has been made; the samples up to it
+	// become readable
+	void endFrame(uint64_t cycle);
+
+	// Copies out up to count finished samples, returns how many
+	size_t readSamples(int16_t* out, size_t count);
+	size_t samplesAvailable() const { return static_cast<size_t>(offset >> TimeBits); }
+
+	// Output rate in samples per second, nudged by the frontend to keep
+	// its queue level. Takes effect from the last endFrame cycle on
+	void setRate(double sampleRate);
+
+	// The APU's clock jumped (save state load, rewind). Later changes
+	// are timed from cycle, picking up where the output is now
+	void setTime(uint64_t cycle) { baseCycle = cycle; }
+
+private:
+	static constexpr int TimeBits = 32;  // Fraction bits of sample positions
+	static constexpr int PhaseBits = 6;
+	static constexpr int Phases = 1 << PhaseBits;
+	static constexpr int Width = 16;     // Kernel taps, also the output delay
+
+	// One step impulse per phase, built once at startup
+	static const std::array<std::array<float, Width>, Phases> kernels;
+
+	double clockRate;
+	uint64_t factor;        // Samples per cycle, fixed point
+	uint64_t baseCycle = 0; // Cycle at offset
+	uint64_t offset = 0;    // Position of baseCycle in the buffer, fixed point
+	std::vector<float> buffer;
+	float level = 0;        // Last level passed to outputChanged
+
+	// Integrator and high-pass state, the DC blocker stands in for the
+	// console's output capacitor
+	float sum = 0;
+	float lastSum = 0;
+	float highPass = 0;
+	float highPassFactor;
+};
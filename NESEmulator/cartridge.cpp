@@ -2,6 +2,7 @@
 #include "mapper0.cpp"
 #include <iostream>
 #include <fstream>
+#include <cstring>
 
 
 bool Cartridge::loadROM(std::string filename)
@@ -82,6 +83,21 @@ bool Cartridge::loadROM(std::string filename)
 			return false;
 	}
 
+	romHash = 0xCBF29CE484222325;
+	for (const std::vector<uint8_t>* rom : { &prgROM, &chrROM })
+	{
+		for (uint8_t byte : *rom)
+			romHash = (romHash ^ byte) * 0x100000001B3;
+	}
+
+	decodeTiles();
+	mapCHRPages();
+
+	if (bankSwitchListener)
+		bankSwitchListener();
+	if (mirroringListener)
+		mirroringListener();
+
 	std::cout << "ROM Loaded Successfully.\n";
 	return true;
 }
@@ -99,6 +115,27 @@ void Cartridge::cpuWrite(uint16_t addr, uint8_t data)
 	uint32_t mappedAddr = 0;
 	if (mapper->cpuMapWrite(addr, mappedAddr))
 		prgROM[mappedAddr] = data;
+	if (mapper->takePRGBankChange() && bankSwitchListener)
+		bankSwitchListener();
+	if (mapper->takeCHRBankChange())
+		mapCHRPages();
+
+	int mode = mapper->takeMirroringChange();
+	if (mode >= 0)
+		setMode(static_cast<MirroringType>(mode));
+}
+
+uint8_t* Cartridge::getPRGPage(uint8_t page)
+{
+	uint32_t mappedAddr = 0;
+	if (mapper && mapper->cpuMapRead(page << 8, mappedAddr) && mappedAddr < prgROM.size())
+		return &prgROM[mappedAddr];
+	return nullptr;
+}
+
+void Cartridge::setBankSwitchListener(std::function<void()> listener)
+{
+	bankSwitchListener = std::move(listener);
 }
 
 uint8_t Cartridge::chrRead(uint16_t addr)
@@ -126,6 +163,7 @@ void Cartridge::chrWrite(uint16_t addr, uint8_t data)
 		if (usesCHR_RAM)
 		{
 			chrRAM[mappedAddr] = data;  // Write to RAM
+			decodeTileRow(mappedAddr);
 		}
 		else if (!usesCHR_RAM)
 		{
@@ -135,6 +173,88 @@ void Cartridge::chrWrite(uint16_t addr, uint8_t data)
 	}
 }
 
+void Cartridge::decodeTiles()
+{
+	const std::vector<uint8_t>& chr = usesCHR_RAM ? chrRAM : chrROM;
+	tileCache.assign((chr.size() / 16 + 64) * 128, 0);
+
+	for (uint32_t addr = 0; addr < chr.size(); addr += 16)
+	{
+		for (uint32_t row = 0; row < 8; row++)
+			decodeTileRow(addr + row);
+	}
+}
+
+// Redecodes the row holding a CHR byte, either plane
+void Cartridge::decodeTileRow(uint32_t chrAddr)
+{
+	const std::vector<uint8_t>& chr = usesCHR_RAM ? chrRAM : chrROM;
+	uint32_t rowAddr = chrAddr & ~0x08;
+	uint8_t plane0 = chr[rowAddr];
+	uint8_t plane1 = chr[rowAddr + 8];
+
+	uint8_t* row = &tileCache[(rowAddr >> 4) * 128 + (rowAddr & 0x07) * 8];
+	for (int col = 0; col < 8; col++)
+	{
+		uint8_t pixel = (((plane1 >> (7 - col)) & 1) << 1) | ((plane0 >> (7 - col)) & 1);
+		row[col] = pixel;
+		row[64 + 7 - col] = pixel;
+	}
+}
+
+// Points each 1KB page of pattern table space at its decoded tiles
+void Cartridge::mapCHRPages()
+{
+	const std::vector<uint8_t>& chr = usesCHR_RAM ? chrRAM : chrROM;
+	uint32_t blank = static_cast<uint32_t>(chr.size() / 16) * 128;
+
+	for (uint32_t page = 0; page < 8; page++)
+	{
+		uint32_t mappedAddr = 0;
+		if (mapper->chrMapRead(page << 10, mappedAddr) && mappedAddr < chr.size())
+			chrPages[page] = (mappedAddr >> 4) * 128;
+		else
+			chrPages[page] = blank;
+	}
+}
+
+void Cartridge::serialize(StateStream& state)
+{
+	state(mirroring);
+
+	// A loaded state is usually close to the current one, only the
+	// tiles that differ are copied and redecoded
+	if (state.isLoading() && usesCHR_RAM)
+	{
+		const uint8_t* chr = state.read(chrRAM.size());
+		for (uint32_t addr = 0; chr && addr < chrRAM.size(); addr += 16)
+		{
+			if (std::memcmp(&chrRAM[addr], chr + addr, 16) == 0)
+				continue;
+
+			std::memcpy(&chrRAM[addr], chr + addr, 16);
+			for (uint32_t row = 0; row < 8; row++)
+				decodeTileRow(addr + row);
+		}
+	}
+	else
+	{
+		state(chrRAM);
+	}
+
+	mapper->serialize(state);
+
+	if (state.isLoading())
+	{
+		mapCHRPages();
+
+		if (bankSwitchListener)
+			bankSwitchListener();
+		if (mirroringListener)
+			mirroringListener();
+	}
+}
+
 Cartridge::MirroringType Cartridge::getMode()
 {
 	return mirroring;
@@ -143,6 +263,13 @@ Cartridge::MirroringType Cartridge::getMode()
 void Cartridge::setMode(MirroringType mode)
 {
 	mirroring = mode;
+	if (mirroringListener)
+		mirroringListener();
+}
+
+void Cartridge::setMirroringListener(std::function<void()> listener)
+{
+	mirroringListener = std::move(listener);
 }
 
 int Cartridge::getMapperID()
@@ -4,7 +4,9 @@
 #include <array>
 #include <string>
 #include <memory>
+#include <functional>
 #include "mapper.h"
+#include "savestate.h"
 
 class Cartridge
 {
@@ -20,8 +22,20 @@ private:
 	bool hasTrainer;
 	bool hasBattery;
 	bool usesCHR_RAM;
+	uint64_t romHash = 0;
 
 	std::unique_ptr<Mapper> mapper;
+	std::function<void()> bankSwitchListener;
+	std::function<void()> mirroringListener;
+
+	// Every CHR tile decoded to 2-bit pixel indices: 8 rows of 8 pixels,
+	// then the same rows mirrored, followed by one page of blank tiles
+	std::vector<uint8_t> tileCache;
+	std::array<uint32_t, 8> chrPages; // tileCache offset of each 1KB PPU page
+
+	void decodeTiles();
+	void decodeTileRow(uint32_t chrAddr);
+	void mapCHRPages();
 
 public:
 	enum MirroringType {
@@ -36,12 +50,33 @@ public:
 	uint8_t cpuRead(uint16_t addr);
 	void cpuWrite(uint16_t addr, uint8_t data);
 
+	// Host pointer to the PRG bytes behind a 256-byte CPU page, or null
+	// if the page is unmapped. Valid until the next bank switch
+	uint8_t* getPRGPage(uint8_t page);
+	void setBankSwitchListener(std::function<void()> listener);
+
 	uint8_t chrRead(uint16_t addr);
 	void chrWrite(uint16_t addr, uint8_t data);
 
+	// The 8 pixels of the pattern row at a PPU address (tile * 16 + fine Y),
+	// left to right, or right to left when flipH is set
+	const uint8_t* getTileRow(uint16_t addr, bool flipH = false) const
+	{
+		return &tileCache[chrPages[(addr >> 10) & 0x07] + ((addr & 0x03F0) << 3) + (flipH ? 64 : 0) + ((addr & 0x07) << 3)];
+	}
+
 	MirroringType getMode();
 	void setMode(MirroringType mode);
+	void setMirroringListener(std::function<void()> listener);
 
 	int getMapperID();
+
+	// FNV-1a over the PRG and CHR ROM, identifies the game in save states
+	uint64_t getROMHash() const { return romHash; }
+
+	// CHR RAM, mirroring and mapper registers. Loading redecodes the tile
+	// cache and calls both listeners so everything mapped from the
+	// cartridge is rebuilt
+	void serialize(StateStream& state);
 };
 
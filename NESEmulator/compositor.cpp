@@ -0,0 +1,81 @@
+#include "compositor.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COMPOSITOR_SSE2
+#include <emmintrin.h>
+#endif
+
+bool composePixelsScalar(const uint8_t* bg, const uint8_t* sprite, uint8_t* out, int start, int end, uint8_t mask)
+{
+	bool hit = false;
+
+	for (int x = start; x < end; x++)
+	{
+		bool bgEnabled = (mask & 0x08) && (x >= 8 || (mask & 0x02));
+		bool spriteEnabled = (mask & 0x10) && (x >= 8 || (mask & 0x04));
+
+		uint8_t bgPixel = bgEnabled ? bg[x] : 0;
+		uint8_t spritePixel = spriteEnabled ? (sprite[x] & 0x1F) : 0;
+
+		if (spritePixel && (!bgPixel || !(sprite[x] & SpriteBehind)))
+			out[x] = spritePixel;
+		else
+			out[x] = bgPixel;
+
+		// Hits ignore the left column clipping, but never happen on x = 255
+		if ((sprite[x] & SpriteZero) && bg[x] && x < 255 && (mask & 0x10))
+			hit = true;
+	}
+
+	return hit;
+}
+
+bool composePixels(const uint8_t* bg, const uint8_t* sprite, uint8_t* out, int start, int end, uint8_t mask)
+{
+#ifdef COMPOSITOR_SSE2
+	// The left column has its own clipping bits, leave it to the scalar path
+	int x = std::max(start, 8);
+	bool hit = composePixelsScalar(bg, sprite, out, start, std::min(x, end), mask);
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bgEnabled = _mm_set1_epi8((mask & 0x08) ? -1 : 0);
+	const __m128i spriteEnabled = _mm_set1_epi8((mask & 0x10) ? -1 : 0);
+	const __m128i colorBits = _mm_set1_epi8(0x1F);
+	const __m128i behindBit = _mm_set1_epi8(SpriteBehind);
+	const __m128i zeroBit = _mm_set1_epi8(SpriteZero);
+
+	for (; x + 16 <= end; x += 16)
+	{
+		__m128i bgRaw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bg + x));
+		__m128i spriteRaw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sprite + x));
+
+		__m128i bgPixel = _mm_and_si128(bgRaw, bgEnabled);
+		__m128i spritePixel = _mm_and_si128(_mm_and_si128(spriteRaw, colorBits), spriteEnabled);
+
+		// Sprite wins where it is opaque and either in front or over a
+		// transparent background
+		__m128i spriteOpaque = _mm_xor_si128(_mm_cmpeq_epi8(spritePixel, zero), _mm_set1_epi8(-1));
+		__m128i bgClear = _mm_cmpeq_epi8(bgPixel, zero);
+		__m128i inFront = _mm_cmpeq_epi8(_mm_and_si128(spriteRaw, behindBit), zero);
+		__m128i useSprite = _mm_and_si128(spriteOpaque, _mm_or_si128(bgClear, inFront));
+
+		__m128i result = _mm_or_si128(_mm_and_si128(useSprite, spritePixel), _mm_andnot_si128(useSprite, bgPixel));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), result);
+
+		__m128i zeroPixel = _mm_cmpeq_epi8(_mm_and_si128(spriteRaw, zeroBit), zeroBit);
+		__m128i bgOpaque = _mm_andnot_si128(_mm_cmpeq_epi8(bgRaw, zero), zeroPixel);
+		int hits = _mm_movemask_epi8(_mm_and_si128(bgOpaque, spriteEnabled));
+		if (x + 16 > 255)
+			hits &= ~(1 << (255 - x));
+		if (hits)
+			hit = true;
+	}
+
+	if (composePixelsScalar(bg, sprite, out, x, end, mask))
+		hit = true;
+	return hit;
+#else
+	return composePixelsScalar(bg, sprite, out, start, end, mask);
+#endif
+}
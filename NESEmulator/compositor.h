@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+
+// Inputs to composePixels, one byte per pixel of a line.
+// Background: palette address 0x01-0x0F, or 0 when transparent.
+// Sprite: palette address 0x10-0x1F, or 0 when no sprite covers the
+// pixel, combined with these flags
+enum SpritePixelFlags : uint8_t
+{
+	SpriteBehind = 0x20, // Priority bit set, drawn behind the background
+	SpriteZero = 0x40    // Pixel belongs to sprite 0
+};
+
+// Muxes pixels [start, end) into the palette address that ends up on
+// screen, applying PPUMASK's enable and left column bits. Returns true
+// if an opaque sprite 0 pixel met an opaque background pixel.
+// Uses SSE2 where the target has it
+bool composePixels(const uint8_t* bg, const uint8_t* sprite, uint8_t* out, int start, int end, uint8_t mask);
+
+// Reference version, also used for the pixels SSE2 can't cover
+bool composePixelsScalar(const uint8_t* bg, const uint8_t* sprite, uint8_t* out, int start, int end, uint8_t mask);
@@ -1,7 +1,4 @@
 #include "cpu.h"
-#include <iostream>
-#include <sstream>
-#include <iomanip>
 #include <cstdlib>
 
 // Control Flags
@@ -19,7 +16,17 @@ CPU::CPU(Memory* memory, NEW_PPU* ppu)
 {
 	this->memory = memory;
 	this->ppu = ppu;
+	this->ram = memory->getRAM();
 	reset();
+
+	// Every component is timed against this CPU's cycle counter
+	scheduler.setClock(&cycles);
+	scheduler.setHandler(EventType::NMI, [this]() { handleNMI(); });
+	scheduler.setHandler(EventType::DMA, [this]() { runDMA(); });
+	ppu->setClock(&cycles);
+	ppu->setScheduler(&scheduler);
+	memory->setScheduler(&scheduler);
+	ppu->catchUp();
 }
 
 void CPU::reset()
@@ -31,40 +38,44 @@ void CPU::reset()
 	PC = (static_cast<uint16_t>(getMemory(0xFFFD)) << 8) | static_cast<uint16_t>(getMemory(0xFFFC));
 	//PC = 0x8000; // FOR TESTING
 	cycles = 0;
-	ram.fill(0);
-	opName = "JMP";
 }
 
-void CPU::step()
+void CPU::serialize(StateStream& state)
 {
-	if (ppu->isDMATriggered())
-	{
-		uint16_t dmaAddr = static_cast<uint16_t>(ppu->getDMAPage()) << 8;
-		ppu->writeRegister(0x3, 0x00);
-		for (int i = 0; i < 256; ++i)
-		{
-			ppu->writeRegister(0x4, getMemory(dmaAddr + i));
-		}
-		cycles += 513 + (cycles % 2);
-		ppu->clearDMA();
-	}
+	state(A);
+	state(X);
+	state(Y);
+	state(SP);
+	state(SR);
+	state(PC);
+	state(cycles);
+	scheduler.serialize(state);
+}
 
-	if (irqPending && !(SR & I_FLAG))
+template<bool Trace>
+void CPU::step()
+{
+	if (scheduler.irqAsserted() && !(SR & I_FLAG))
 	{
 		handleIRQ();
-		irqPending = false;
 	}
 
-	uint64_t startCycles = cycles;
-	//logState(opName);
 	uint8_t opcode = getMemory(PC++);
+	if constexpr (Trace)
+	{
+		traceState(PC - 1, opcode);
+	}
 	execute(opcode);
-	opName = getOpName(opcode);
-	
-	uint64_t deltaCycles = cycles - startCycles;
-	ppu->step(deltaCycles);
+
+	if (cycles >= scheduler.nextEvent())
+	{
+		scheduler.run();
+	}
 }
 
+template void CPU::step<false>();
+template void CPU::step<true>();
+
 void CPU::handleNMI()
 {
 	//printf("NMI entered, PC=%04X\n", PC);
@@ -74,1078 +85,532 @@ void CPU::handleNMI()
 	SR |= I_FLAG;
 	PC = getMemory(0xFFFA) | (static_cast<uint16_t>(getMemory(0xFFFB)) << 8);
 	cycles += 7;
-	ppu->clearNMI();
 }
 
 void CPU::handleIRQ()
 {
 	push((PC >> 8) & 0xFF); 
 	push(PC & 0xFF); 
-	push(SR | B_FLAG | U_FLAG); 
+	push(SR & ~B_FLAG | U_FLAG); 
 	SR |= I_FLAG; 
 	PC = getMemory(0xFFFE) | (static_cast<uint16_t>(getMemory(0xFFFF)) << 8); 
 	cycles += 7;
 }
 
-void CPU::execute(uint8_t op)
+void CPU::runDMA()
 {
-	switch (op) 
+	uint16_t dmaAddr = static_cast<uint16_t>(ppu->getDMAPage()) << 8;
+	ppu->writeRegister(0x3, 0x00);
+	for (int i = 0; i < 256; ++i)
 	{
-	case 0xA9: // LDA Immediate
-	case 0xA5: // LDA Zero Page
-	case 0xB5:
-	case 0xAD: // LDA Absolute
-	case 0xBD:
-	case 0xB9:
-	case 0xA1:
-	case 0xB1:
-		LDA(op);
-		break;
-	case 0xA2:
-	case 0xA6:
-	case 0xB6:
-	case 0xAE:
-	case 0xBE:
-		LDX(op);
-		break;
-	case 0xA0:
-	case 0xA4:
-	case 0xB4:
-	case 0xAC:
-	case 0xBC:
-		LDY(op);
-		break;
-	case 0x85:
-	case 0x95:
-	case 0x8D:
-	case 0x9D:
-	case 0x99:
-	case 0x81:
-	case 0x91:
-		STA(op);
-		break;
-	case 0x86:
-	case 0x96:
-	case 0x8E:
-		STX(op);
-		break;
-	case 0x84:
-	case 0x94:
-	case 0x8C:
-		STY(op);
-		break;
-	case 0xAA:
-		TAX();
-		break;
-	case 0xA8:
-		TAY();
-		break;
-	case 0x8A:
-		TXA();
-		break;
-	case 0x98:
-		TYA();
-		break;
-	case 0xBA:
-		TSX();
-		break;
-	case 0x9A:
-		TXS();
-		break;
-	case 0x48:
-		PHA();
-		break;
-	case 0x08:
-		PHP();
-		break;
-	case 0x68:
-		PLA();
-		break;
-	case 0x28:
-		PLP();
-		break;
-	case 0x29:
-	case 0x25:
-	case 0x35:
-	case 0x2D:
-	case 0x3D:
-	case 0X39:
-	case 0x21:
-	case 0x31:
-		AND(op);
-		break;
-	case 0x49:
-	case 0x45:
-	case 0x55:
-	case 0x4D:
-	case 0x5D:
-	case 0x59:
-	case 0x41:
-	case 0x51:
-		EOR(op);
-		break;
-	case 0x09:
-	case 0x05:
-	case 0x15:
-	case 0x0D:
-	case 0x1D:
-	case 0x19:
-	case 0x01:
-	case 0x11:
-		ORA(op);
-		break;
-	case 0x24:
-	case 0x2C:
-		BIT(op);
-		break;
-	case 0x69:
-	case 0x65:
-	case 0x75:
-	case 0x6D:
-	case 0x7D:
-	case 0x79:
-	case 0x61:
-	case 0x71:
-		ADC(op);
-		break;
-	case 0xE9:
-	case 0xE5:
-	case 0xF5:
-	case 0xED:
-	case 0xFD:
-	case 0xF9:
-	case 0xE1:
-	case 0xF1:
-	case 0xEB:
-		SBC(op);
-		break;
-	case 0xC9:
-	case 0xC5:
-	case 0xD5:
-	case 0xCD:
-	case 0xDD:
-	case 0xD9:
-	case 0xC1:
-	case 0xD1:
-		CMP(op);
-		break;
-	case 0xE0:
-	case 0xE4:
-	case 0xEC:
-		CPX(op);
-		break;
-	case 0xC0:
-	case 0xC4:
-	case 0xCC:
-		CPY(op);
-		break;
-	case 0xE6:
-	case 0xF6:
-	case 0xEE:
-	case 0xFE:
-		INC(op);
-		break;
-	case 0xE8:
-		INX();
-		break;
-	case 0xC8:
-		INY();
-		break;
-	case 0xC6:
-	case 0xD6:
-	case 0xCE:
-	case 0xDE:
-		DEC(op);
-		break;
-	case 0xCA:
-		DEX();
-		break;
-	case 0x88:
-		DEY();
-		break;
-	case 0x0A:
-	case 0x06:
-	case 0x16:
-	case 0x0E:
-	case 0x1E:
-		ASL(op);
-		break;
-	case 0x4A:
-	case 0x46:
-	case 0x56:
-	case 0x4E:
-	case 0x5E:
-		LSR(op);
-		break;
-	case 0x2A:
-	case 0x26:
-	case 0x36:
-	case 0x2E:
-	case 0x3E:
-		ROL(op);
-		break;
-	case 0x6A:
-	case 0x66:
-	case 0x76:
-	case 0x6E:
-	case 0x7E:
-		ROR(op);
-		break;
-	case 0x4C:
-	case 0x6C:
-		JMP(op);
-		break;
-	case 0x20:
-		JSR();
-		break;
-	case 0x60:
-		RTS();
-		break;
-	case 0x90:
-		BCC();
-		break;
-	case 0xB0:
-		BCS();
-		break;
-	case 0xF0:
-		BEQ();
-		break;
-	case 0x30:
-		BMI();
-		break;
-	case 0xD0:
-		BNE();
-		break;
-	case 0x10:
-		BPL();
-		break;
-	case 0x50:
-		BVC();
-		break;
-	case 0x70:
-		BVS();
-		break;
-	case 0x18:
-		CLC();
-		break;
-	case 0xD8:
-		CLD();
-		break;
-	case 0x58:
-		CLI();
-		break;
-	case 0xB8:
-		CLV();
-		break;
-	case 0x38:
-		SEC();
-		break;
-	case 0xF8:
-		SED();
-		break;
-	case 0x78:
-		SEI();
-		break;
-	case 0x40:
-		RTI();
-		break;
-	case 0xEA:
-	case 0x04:
-	case 0x44:
-	case 0x64:
-	case 0x0C:
-	case 0x14:
-	case 0x34:
-	case 0x54:
-	case 0x74:
-	case 0xD4:
-	case 0xF4:
-	case 0x1A:
-	case 0x3A:
-	case 0x5A:
-	case 0x7A:
-	case 0xDA:
-	case 0xFA:
-	case 0x80:
-	case 0x1C:
-	case 0x3C:
-	case 0x5C:
-	case 0x7C:
-	case 0xDC:
-	case 0xFC:
-		NOP(op);
-		break;
-	case 0x00:
-		BRK();
-		break;
-	case 0xA3:
-	case 0xA7:
-	case 0xAF:
-	case 0xB3:
-	case 0xB7:
-	case 0xBF:
-		LAX(op);
-		break;
-	case 0x83:
-	case 0x87:
-	case 0x8F:
-	case 0x97:
-		SAX(op);
-		break;
-	case 0xC3:
-	case 0xC7:
-	case 0xCF:
-	case 0xD3:
-	case 0xD7:
-	case 0xDB:
-	case 0xDF:
-		DCP(op);
-		break;
-	case 0xE3:
-	case 0xE7:
-	case 0xEF:
-	case 0xF3:
-	case 0xF7:
-	case 0xFB:
-	case 0xFF:
-		ISB(op);
-		break;
-	case 0x03:
-	case 0x07:
-	case 0x0F:
-	case 0x13:
-	case 0x17:
-	case 0x1B:
-	case 0x1F:
-		SLO(op);
-		break;
-	case 0x23:
-	case 0x27:
-	case 0x2F:
-	case 0x33:
-	case 0x37:
-	case 0x3B:
-	case 0x3F:
-		RLA(op);
-		break;
-	case 0x43:
-	case 0x47:
-	case 0x4F:
-	case 0x53:
-	case 0x57:
-	case 0x5B:
-	case 0x5F:
-		SRE(op);
-		break;
-	case 0x63:
-	case 0x67:
-	case 0x6F:
-	case 0x73:
-	case 0x77:
-	case 0x7B:
-	case 0x7F:
-		RRA(op);
-		break;
-	default:
-		break;
+		ppu->writeRegister(0x4, getMemory(dmaAddr + i));
 	}
+	cycles += 513 + (cycles % 2);
 }
 
-// LOAD / STORE
-void CPU::LDA(uint8_t op)
+template<void (CPU::*Handler)(uint16_t), CPU::AddressingMode Mode, uint8_t Cycles, uint8_t PageCycles>
+constexpr CPU::Instruction CPU::makeInstruction()
 {
-	//std::cout << "LDA ";
-	uint8_t value = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-		case 0xA9: //Immediate
-			value = getImmediate();
-			cycles += 2;
-			break;
-		case 0xA5:
-			value = getMemory(getZeroPageAddress());
-			cycles += 3;
-			break;
-		case 0xB5:
-			value = getMemory((getZeroPageAddress() + X) & 0xFF);
-			cycles += 4;
-			break;
-		case 0xAD:
-			value = getMemory(getAbsoluteAddress());
-			cycles += 4;
-			break;
-		case 0xBD:
-			value = getMemory(getAbsoluteIndexedAddress(X, pageCrossed));
-			cycles += pageCrossed ? 5 : 4;
-			break;
-		case 0xB9:
-			value = getMemory(getAbsoluteIndexedAddress(Y, pageCrossed));
-			cycles += pageCrossed ? 5 : 4;
-			break;
-		case 0xA1:
-			value = getMemory(getIndirectAddress());
-			cycles += 6;
-			break;
-		case 0xB1:
-			value = getMemory(getIndirectIndexedAddress(pageCrossed));
-			cycles += pageCrossed ? 6 : 5;
-			break;
-	}
+	return { &CPU::op<Handler, Mode, Cycles, PageCycles>, Mode, Cycles, PageCycles };
+}
 
-	/*std::cout << std::hex << "LDA: " << static_cast<int>(value) << std::endl;*/
-	A = value;
-	updateZeroNegativeFlags(A);
+constexpr std::array<CPU::Instruction, 256> CPU::buildOpcodeTable()
+{
+	using M = AddressingMode;
+	std::array<Instruction, 256> table{};
+
+	// Unimplemented opcodes fall through as single byte no-ops
+	for (Instruction& entry : table)
+		entry = makeInstruction<&CPU::XXX, M::Implied, 0>();
+
+	// Load & Store
+	table[0xA9] = makeInstruction<&CPU::LDA, M::Immediate, 2>();
+	table[0xA5] = makeInstruction<&CPU::LDA, M::ZeroPage, 3>();
+	table[0xB5] = makeInstruction<&CPU::LDA, M::ZeroPageX, 4>();
+	table[0xAD] = makeInstruction<&CPU::LDA, M::Absolute, 4>();
+	table[0xBD] = makeInstruction<&CPU::LDA, M::AbsoluteX, 4, 1>();
+	table[0xB9] = makeInstruction<&CPU::LDA, M::AbsoluteY, 4, 1>();
+	table[0xA1] = makeInstruction<&CPU::LDA, M::IndirectX, 6>();
+	table[0xB1] = makeInstruction<&CPU::LDA, M::IndirectY, 5, 1>();
+
+	table[0xA2] = makeInstruction<&CPU::LDX, M::Immediate, 2>();
+	table[0xA6] = makeInstruction<&CPU::LDX, M::ZeroPage, 3>();
+	table[0xB6] = makeInstruction<&CPU::LDX, M::ZeroPageY, 4>();
+	table[0xAE] = makeInstruction<&CPU::LDX, M::Absolute, 4>();
+	table[0xBE] = makeInstruction<&CPU::LDX, M::AbsoluteY, 4, 1>();
+
+	table[0xA0] = makeInstruction<&CPU::LDY, M::Immediate, 2>();
+	table[0xA4] = makeInstruction<&CPU::LDY, M::ZeroPage, 3>();
+	table[0xB4] = makeInstruction<&CPU::LDY, M::ZeroPageX, 4>();
+	table[0xAC] = makeInstruction<&CPU::LDY, M::Absolute, 4>();
+	table[0xBC] = makeInstruction<&CPU::LDY, M::AbsoluteX, 4, 1>();
+
+	table[0xA7] = makeInstruction<&CPU::LAX, M::ZeroPage, 3>();
+	table[0xB7] = makeInstruction<&CPU::LAX, M::ZeroPageY, 4>();
+	table[0xAF] = makeInstruction<&CPU::LAX, M::Absolute, 4>();
+	table[0xBF] = makeInstruction<&CPU::LAX, M::AbsoluteY, 4, 1>();
+	table[0xA3] = makeInstruction<&CPU::LAX, M::IndirectX, 6>();
+	table[0xB3] = makeInstruction<&CPU::LAX, M::IndirectY, 5, 1>();
+
+	table[0x85] = makeInstruction<&CPU::STA, M::ZeroPage, 3>();
+	table[0x95] = makeInstruction<&CPU::STA, M::ZeroPageX, 4>();
+	table[0x8D] = makeInstruction<&CPU::STA, M::Absolute, 4>();
+	table[0x9D] = makeInstruction<&CPU::STA, M::AbsoluteX, 5>();
+	table[0x99] = makeInstruction<&CPU::STA, M::AbsoluteY, 5>();
+	table[0x81] = makeInstruction<&CPU::STA, M::IndirectX, 6>();
+	table[0x91] = makeInstruction<&CPU::STA, M::IndirectY, 6>();
+
+	table[0x86] = makeInstruction<&CPU::STX, M::ZeroPage, 3>();
+	table[0x96] = makeInstruction<&CPU::STX, M::ZeroPageY, 4>();
+	table[0x8E] = makeInstruction<&CPU::STX, M::Absolute, 4>();
+
+	table[0x84] = makeInstruction<&CPU::STY, M::ZeroPage, 3>();
+	table[0x94] = makeInstruction<&CPU::STY, M::ZeroPageX, 4>();
+	table[0x8C] = makeInstruction<&CPU::STY, M::Absolute, 4>();
+
+	table[0x87] = makeInstruction<&CPU::SAX, M::ZeroPage, 3>();
+	table[0x97] = makeInstruction<&CPU::SAX, M::ZeroPageY, 4>();
+	table[0x8F] = makeInstruction<&CPU::SAX, M::Absolute, 4>();
+	table[0x83] = makeInstruction<&CPU::SAX, M::IndirectX, 6>();
+
+	// Register Transfer
+	table[0xAA] = makeInstruction<&CPU::TAX, M::Implied, 2>();
+	table[0xA8] = makeInstruction<&CPU::TAY, M::Implied, 2>();
+	table[0x8A] = makeInstruction<&CPU::TXA, M::Implied, 2>();
+	table[0x98] = makeInstruction<&CPU::TYA, M::Implied, 2>();
+
+	// Stack Operations
+	table[0xBA] = makeInstruction<&CPU::TSX, M::Implied, 2>();
+	table[0x9A] = makeInstruction<&CPU::TXS, M::Implied, 2>();
+	table[0x48] = makeInstruction<&CPU::PHA, M::Implied, 3>();
+	table[0x08] = makeInstruction<&CPU::PHP, M::Implied, 3>();
+	table[0x68] = makeInstruction<&CPU::PLA, M::Implied, 4>();
+	table[0x28] = makeInstruction<&CPU::PLP, M::Implied, 4>();
+
+	// Logical Operations
+	table[0x29] = makeInstruction<&CPU::AND, M::Immediate, 2>();
+	table[0x25] = makeInstruction<&CPU::AND, M::ZeroPage, 3>();
+	table[0x35] = makeInstruction<&CPU::AND, M::ZeroPageX, 4>();
+	table[0x2D] = makeInstruction<&CPU::AND, M::Absolute, 4>();
+	table[0x3D] = makeInstruction<&CPU::AND, M::AbsoluteX, 4, 1>();
+	table[0x39] = makeInstruction<&CPU::AND, M::AbsoluteY, 4, 1>();
+	table[0x21] = makeInstruction<&CPU::AND, M::IndirectX, 6>();
+	table[0x31] = makeInstruction<&CPU::AND, M::IndirectY, 5, 1>();
+
+	table[0x49] = makeInstruction<&CPU::EOR, M::Immediate, 2>();
+	table[0x45] = makeInstruction<&CPU::EOR, M::ZeroPage, 3>();
+	table[0x55] = makeInstruction<&CPU::EOR, M::ZeroPageX, 4>();
+	table[0x4D] = makeInstruction<&CPU::EOR, M::Absolute, 4>();
+	table[0x5D] = makeInstruction<&CPU::EOR, M::AbsoluteX, 4, 1>();
+	table[0x59] = makeInstruction<&CPU::EOR, M::AbsoluteY, 4, 1>();
+	table[0x41] = makeInstruction<&CPU::EOR, M::IndirectX, 6>();
+	table[0x51] = makeInstruction<&CPU::EOR, M::IndirectY, 5, 1>();
+
+	table[0x09] = makeInstruction<&CPU::ORA, M::Immediate, 2>();
+	table[0x05] = makeInstruction<&CPU::ORA, M::ZeroPage, 3>();
+	table[0x15] = makeInstruction<&CPU::ORA, M::ZeroPageX, 4>();
+	table[0x0D] = makeInstruction<&CPU::ORA, M::Absolute, 4>();
+	table[0x1D] = makeInstruction<&CPU::ORA, M::AbsoluteX, 4, 1>();
+	table[0x19] = makeInstruction<&CPU::ORA, M::AbsoluteY, 4, 1>();
+	table[0x01] = makeInstruction<&CPU::ORA, M::IndirectX, 6>();
+	table[0x11] = makeInstruction<&CPU::ORA, M::IndirectY, 5, 1>();
+
+	table[0x24] = makeInstruction<&CPU::BIT, M::ZeroPage, 3>();
+	table[0x2C] = makeInstruction<&CPU::BIT, M::Absolute, 4>();
+
+	// Arithmetic
+	table[0x69] = makeInstruction<&CPU::ADC, M::Immediate, 2>();
+	table[0x65] = makeInstruction<&CPU::ADC, M::ZeroPage, 3>();
+	table[0x75] = makeInstruction<&CPU::ADC, M::ZeroPageX, 4>();
+	table[0x6D] = makeInstruction<&CPU::ADC, M::Absolute, 4>();
+	table[0x7D] = makeInstruction<&CPU::ADC, M::AbsoluteX, 4, 1>();
+	table[0x79] = makeInstruction<&CPU::ADC, M::AbsoluteY, 4, 1>();
+	table[0x61] = makeInstruction<&CPU::ADC, M::IndirectX, 6>();
+	table[0x71] = makeInstruction<&CPU::ADC, M::IndirectY, 5, 1>();
+
+	table[0xE9] = makeInstruction<&CPU::SBC, M::Immediate, 2>();
+	table[0xEB] = makeInstruction<&CPU::SBC, M::Immediate, 2>();
+	table[0xE5] = makeInstruction<&CPU::SBC, M::ZeroPage, 3>();
+	table[0xF5] = makeInstruction<&CPU::SBC, M::ZeroPageX, 4>();
+	table[0xED] = makeInstruction<&CPU::SBC, M::Absolute, 4>();
+	table[0xFD] = makeInstruction<&CPU::SBC, M::AbsoluteX, 4, 1>();
+	table[0xF9] = makeInstruction<&CPU::SBC, M::AbsoluteY, 4, 1>();
+	table[0xE1] = makeInstruction<&CPU::SBC, M::IndirectX, 6>();
+	table[0xF1] = makeInstruction<&CPU::SBC, M::IndirectY, 5, 1>();
+
+	table[0xC9] = makeInstruction<&CPU::CMP, M::Immediate, 2>();
+	table[0xC5] = makeInstruction<&CPU::CMP, M::ZeroPage, 3>();
+	table[0xD5] = makeInstruction<&CPU::CMP, M::ZeroPageX, 4>();
+	table[0xCD] = makeInstruction<&CPU::CMP, M::Absolute, 4>();
+	table[0xDD] = makeInstruction<&CPU::CMP, M::AbsoluteX, 4, 1>();
+	table[0xD9] = makeInstruction<&CPU::CMP, M::AbsoluteY, 4, 1>();
+	table[0xC1] = makeInstruction<&CPU::CMP, M::IndirectX, 6>();
+	table[0xD1] = makeInstruction<&CPU::CMP, M::IndirectY, 5, 1>();
+
+	table[0xE0] = makeInstruction<&CPU::CPX, M::Immediate, 2>();
+	table[0xE4] = makeInstruction<&CPU::CPX, M::ZeroPage, 3>();
+	table[0xEC] = makeInstruction<&CPU::CPX, M::Absolute, 4>();
+
+	table[0xC0] = makeInstruction<&CPU::CPY, M::Immediate, 2>();
+	table[0xC4] = makeInstruction<&CPU::CPY, M::ZeroPage, 3>();
+	table[0xCC] = makeInstruction<&CPU::CPY, M::Absolute, 4>();
+
+	table[0xE7] = makeInstruction<&CPU::ISB, M::ZeroPage, 5>();
+	table[0xF7] = makeInstruction<&CPU::ISB, M::ZeroPageX, 6>();
+	table[0xEF] = makeInstruction<&CPU::ISB, M::Absolute, 6>();
+	table[0xFF] = makeInstruction<&CPU::ISB, M::AbsoluteX, 7>();
+	table[0xFB] = makeInstruction<&CPU::ISB, M::AbsoluteY, 6, 1>();
+	table[0xE3] = makeInstruction<&CPU::ISB, M::IndirectX, 8>();
+	table[0xF3] = makeInstruction<&CPU::ISB, M::IndirectY, 7, 1>();
+
+	// Increments & Decrements
+	table[0xE6] = makeInstruction<&CPU::INC, M::ZeroPage, 5>();
+	table[0xF6] = makeInstruction<&CPU::INC, M::ZeroPageX, 6>();
+	table[0xEE] = makeInstruction<&CPU::INC, M::Absolute, 6>();
+	table[0xFE] = makeInstruction<&CPU::INC, M::AbsoluteX, 7>();
+	table[0xE8] = makeInstruction<&CPU::INX, M::Implied, 2>();
+	table[0xC8] = makeInstruction<&CPU::INY, M::Implied, 2>();
+
+	table[0xC6] = makeInstruction<&CPU::DEC, M::ZeroPage, 5>();
+	table[0xD6] = makeInstruction<&CPU::DEC, M::ZeroPageX, 6>();
+	table[0xCE] = makeInstruction<&CPU::DEC, M::Absolute, 6>();
+	table[0xDE] = makeInstruction<&CPU::DEC, M::AbsoluteX, 7>();
+	table[0xCA] = makeInstruction<&CPU::DEX, M::Implied, 2>();
+	table[0x88] = makeInstruction<&CPU::DEY, M::Implied, 2>();
+
+	table[0xC7] = makeInstruction<&CPU::DCP, M::ZeroPage, 5>();
+	table[0xD7] = makeInstruction<&CPU::DCP, M::ZeroPageX, 6>();
+	table[0xCF] = makeInstruction<&CPU::DCP, M::Absolute, 6>();
+	table[0xDF] = makeInstruction<&CPU::DCP, M::AbsoluteX, 7>();
+	table[0xDB] = makeInstruction<&CPU::DCP, M::AbsoluteY, 6, 1>();
+	table[0xC3] = makeInstruction<&CPU::DCP, M::IndirectX, 8>();
+	table[0xD3] = makeInstruction<&CPU::DCP, M::IndirectY, 7, 1>();
+
+	// Shifts
+	table[0x0A] = makeInstruction<&CPU::ASL_A, M::Accumulator, 2>();
+	table[0x06] = makeInstruction<&CPU::ASL, M::ZeroPage, 5>();
+	table[0x16] = makeInstruction<&CPU::ASL, M::ZeroPageX, 6>();
+	table[0x0E] = makeInstruction<&CPU::ASL, M::Absolute, 6>();
+	table[0x1E] = makeInstruction<&CPU::ASL, M::AbsoluteX, 7>();
+
+	table[0x4A] = makeInstruction<&CPU::LSR_A, M::Accumulator, 2>();
+	table[0x46] = makeInstruction<&CPU::LSR, M::ZeroPage, 5>();
+	table[0x56] = makeInstruction<&CPU::LSR, M::ZeroPageX, 6>();
+	table[0x4E] = makeInstruction<&CPU::LSR, M::Absolute, 6>();
+	table[0x5E] = makeInstruction<&CPU::LSR, M::AbsoluteX, 7>();
+
+	table[0x2A] = makeInstruction<&CPU::ROL_A, M::Accumulator, 2>();
+	table[0x26] = makeInstruction<&CPU::ROL, M::ZeroPage, 5>();
+	table[0x36] = makeInstruction<&CPU::ROL, M::ZeroPageX, 6>();
+	table[0x2E] = makeInstruction<&CPU::ROL, M::Absolute, 6>();
+	table[0x3E] = makeInstruction<&CPU::ROL, M::AbsoluteX, 7>();
+
+	table[0x6A] = makeInstruction<&CPU::ROR_A, M::Accumulator, 2>();
+	table[0x66] = makeInstruction<&CPU::ROR, M::ZeroPage, 5>();
+	table[0x76] = makeInstruction<&CPU::ROR, M::ZeroPageX, 6>();
+	table[0x6E] = makeInstruction<&CPU::ROR, M::Absolute, 6>();
+	table[0x7E] = makeInstruction<&CPU::ROR, M::AbsoluteX, 7>();
+
+	table[0x07] = makeInstruction<&CPU::SLO, M::ZeroPage, 5>();
+	table[0x17] = makeInstruction<&CPU::SLO, M::ZeroPageX, 6>();
+	table[0x0F] = makeInstruction<&CPU::SLO, M::Absolute, 6>();
+	table[0x1F] = makeInstruction<&CPU::SLO, M::AbsoluteX, 7>();
+	table[0x1B] = makeInstruction<&CPU::SLO, M::AbsoluteY, 6, 1>();
+	table[0x03] = makeInstruction<&CPU::SLO, M::IndirectX, 8>();
+	table[0x13] = makeInstruction<&CPU::SLO, M::IndirectY, 7, 1>();
+
+	table[0x27] = makeInstruction<&CPU::RLA, M::ZeroPage, 5>();
+	table[0x37] = makeInstruction<&CPU::RLA, M::ZeroPageX, 6>();
+	table[0x2F] = makeInstruction<&CPU::RLA, M::Absolute, 6>();
+	table[0x3F] = makeInstruction<&CPU::RLA, M::AbsoluteX, 7>();
+	table[0x3B] = makeInstruction<&CPU::RLA, M::AbsoluteY, 6, 1>();
+	table[0x23] = makeInstruction<&CPU::RLA, M::IndirectX, 8>();
+	table[0x33] = makeInstruction<&CPU::RLA, M::IndirectY, 7, 1>();
+
+	table[0x47] = makeInstruction<&CPU::SRE, M::ZeroPage, 5>();
+	table[0x57] = makeInstruction<&CPU::SRE, M::ZeroPageX, 6>();
+	table[0x4F] = makeInstruction<&CPU::SRE, M::Absolute, 6>();
+	table[0x5F] = makeInstruction<&CPU::SRE, M::AbsoluteX, 7>();
+	table[0x5B] = makeInstruction<&CPU::SRE, M::AbsoluteY, 7>();
+	table[0x43] = makeInstruction<&CPU::SRE, M::IndirectX, 8>();
+	table[0x53] = makeInstruction<&CPU::SRE, M::IndirectY, 8>();
+
+	table[0x67] = makeInstruction<&CPU::RRA, M::ZeroPage, 5>();
+	table[0x77] = makeInstruction<&CPU::RRA, M::ZeroPageX, 6>();
+	table[0x6F] = makeInstruction<&CPU::RRA, M::Absolute, 6>();
+	table[0x7F] = makeInstruction<&CPU::RRA, M::AbsoluteX, 7>();
+	table[0x7B] = makeInstruction<&CPU::RRA, M::AbsoluteY, 7>();
+	table[0x63] = makeInstruction<&CPU::RRA, M::IndirectX, 8>();
+	table[0x73] = makeInstruction<&CPU::RRA, M::IndirectY, 8>();
+
+	// Jumps & Calls
+	table[0x4C] = makeInstruction<&CPU::JMP, M::Absolute, 3>();
+	table[0x6C] = makeInstruction<&CPU::JMP, M::Indirect, 5>();
+	table[0x20] = makeInstruction<&CPU::JSR, M::Absolute, 6>();
+	table[0x60] = makeInstruction<&CPU::RTS, M::Implied, 6>();
+
+	// Branches - taken branches add their own cycles
+	table[0x90] = makeInstruction<&CPU::BCC, M::Relative, 2>();
+	table[0xB0] = makeInstruction<&CPU::BCS, M::Relative, 2>();
+	table[0xF0] = makeInstruction<&CPU::BEQ, M::Relative, 2>();
+	table[0x30] = makeInstruction<&CPU::BMI, M::Relative, 2>();
+	table[0xD0] = makeInstruction<&CPU::BNE, M::Relative, 2>();
+	table[0x10] = makeInstruction<&CPU::BPL, M::Relative, 2>();
+	table[0x50] = makeInstruction<&CPU::BVC, M::Relative, 2>();
+	table[0x70] = makeInstruction<&CPU::BVS, M::Relative, 2>();
+
+	// Status Flag Changes
+	table[0x18] = makeInstruction<&CPU::CLC, M::Implied, 2>();
+	table[0xD8] = makeInstruction<&CPU::CLD, M::Implied, 2>();
+	table[0x58] = makeInstruction<&CPU::CLI, M::Implied, 2>();
+	table[0xB8] = makeInstruction<&CPU::CLV, M::Implied, 2>();
+	table[0x38] = makeInstruction<&CPU::SEC, M::Implied, 2>();
+	table[0xF8] = makeInstruction<&CPU::SED, M::Implied, 2>();
+	table[0x78] = makeInstruction<&CPU::SEI, M::Implied, 2>();
+
+	// System Functions
+	table[0x00] = makeInstruction<&CPU::BRK, M::Implied, 7>();
+	table[0x40] = makeInstruction<&CPU::RTI, M::Implied, 6>();
+
+	for (uint8_t op : { 0xEA, 0x1A, 0x3A, 0x5A, 0x7A, 0xDA, 0xFA })
+		table[op] = makeInstruction<&CPU::NOP, M::Implied, 2>();
+	table[0x80] = makeInstruction<&CPU::NOP, M::Immediate, 2>();
+	for (uint8_t op : { 0x04, 0x44, 0x64 })
+		table[op] = makeInstruction<&CPU::NOP, M::ZeroPage, 3>();
+	for (uint8_t op : { 0x14, 0x34, 0x54, 0x74, 0xD4, 0xF4 })
+		table[op] = makeInstruction<&CPU::NOP, M::ZeroPageX, 4>();
+	table[0x0C] = makeInstruction<&CPU::NOP, M::Absolute, 4>();
+	for (uint8_t op : { 0x1C, 0x3C, 0x5C, 0x7C, 0xDC, 0xFC })
+		table[op] = makeInstruction<&CPU::NOP, M::AbsoluteX, 4, 1>();
+
+	return table;
 }
-void CPU::LDX(uint8_t op)
+
+constinit const std::array<CPU::Instruction, 256> CPU::opcodeTable = CPU::buildOpcodeTable();
+
+void CPU::execute(uint8_t op)
+{
+	(this->*opcodeTable[op].execute)();
+}
+
+template<void (CPU::*Handler)(uint16_t), CPU::AddressingMode Mode, uint8_t Cycles, uint8_t PageCycles>
+void CPU::op()
 {
-	//std::cout << "LDX ";
-	uint8_t value = 0;
-	bool pageCrossed = false;
-	switch (op)
+	Operand operand = fetchOperand<Mode>();
+	(this->*Handler)(operand.addr);
+
+	cycles += Cycles;
+	if constexpr (PageCycles != 0)
 	{
-		case 0xA2:
-			value = getImmediate();
-			cycles += 2;
-			break;
-		case 0xA6:
-			value = getMemory(getZeroPageAddress());
-			cycles += 3;
-			break;
-		case 0xB6:
-			value = getMemory((getZeroPageAddress() + Y) & 0xFF);
-			cycles += 4;
-			break;
-		case 0xAE:
-			value = getMemory(getAbsoluteAddress());
-			cycles += 4;
-			break;
-		case 0xBE:
-			value = getMemory(getAbsoluteIndexedAddress(Y, pageCrossed));
-			cycles += pageCrossed ? 5 : 4;
-			break;
+		if (operand.pageCrossed)
+			cycles += PageCycles;
 	}
-
-	X = value;
-	updateZeroNegativeFlags(X);
 }
-void CPU::LDY(uint8_t op)
+
+template<CPU::AddressingMode Mode>
+CPU::Operand CPU::fetchOperand()
 {
-	/*std::cout << "LDY ";*/
-	uint8_t value = 0;
-	bool pageCrossed = false;
-	switch (op)
+	using M = AddressingMode;
+
+	if constexpr (Mode == M::Immediate || Mode == M::Relative)
+	{
+		return { PC++, false };
+	}
+	else if constexpr (Mode == M::ZeroPage)
+	{
+		return { getZeroPageAddress(), false };
+	}
+	else if constexpr (Mode == M::ZeroPageX)
+	{
+		return { static_cast<uint16_t>((getZeroPageAddress() + X) & 0xFF), false };
+	}
+	else if constexpr (Mode == M::ZeroPageY)
+	{
+		return { static_cast<uint16_t>((getZeroPageAddress() + Y) & 0xFF), false };
+	}
+	else if constexpr (Mode == M::Absolute)
+	{
+		return { getAbsoluteAddress(), false };
+	}
+	else if constexpr (Mode == M::AbsoluteX)
+	{
+		return indexAddress(getAbsoluteAddress(), X);
+	}
+	else if constexpr (Mode == M::AbsoluteY)
+	{
+		return indexAddress(getAbsoluteAddress(), Y);
+	}
+	else if constexpr (Mode == M::Indirect)
+	{
+		// 6502 bug: the pointer's high byte never carries into the next page
+		uint16_t pointer = getAbsoluteAddress();
+		uint8_t low = getMemory(pointer);
+		uint8_t high = getMemory((pointer & 0xFF00) | ((pointer + 1) & 0xFF));
+		return { static_cast<uint16_t>((high << 8) | low), false };
+	}
+	else if constexpr (Mode == M::IndirectX)
+	{
+		return { getIndirectAddress(), false };
+	}
+	else if constexpr (Mode == M::IndirectY)
 	{
-		case 0xA0:
-			value = getImmediate();
-			cycles += 2;
-			break;
-		case 0xA4:
-			value = getMemory(getZeroPageAddress());
-			cycles += 3;
-			break;
-		case 0xB4:
-			value = getMemory((getZeroPageAddress() + X) & 0xFF);
-			cycles += 4;
-			break;
-		case 0xAC:
-			value = getMemory(getAbsoluteAddress());
-			cycles += 4;
-			break;
-		case 0xBC:
-			value = getMemory(getAbsoluteIndexedAddress(X, pageCrossed));
-			cycles += pageCrossed ? 5 : 4;
-			break;
+		return indexAddress(readZeroPagePointer(getZeroPageAddress()), Y);
 	}
+	else
+	{
+		// Implied and accumulator instructions have no operand
+		return { 0, false };
+	}
+}
 
-	Y = value;
+// LOAD / STORE
+void CPU::LDA(uint16_t addr)
+{
+	A = getMemory(addr);
+	updateZeroNegativeFlags(A);
+}
+void CPU::LDX(uint16_t addr)
+{
+	X = getMemory(addr);
+	updateZeroNegativeFlags(X);
+}
+void CPU::LDY(uint16_t addr)
+{
+	Y = getMemory(addr);
 	updateZeroNegativeFlags(Y);
 }
-void CPU::LAX(uint8_t op)
+void CPU::LAX(uint16_t addr)
 {
-	uint8_t value = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-		case 0xA7:
-			value = getMemory(getZeroPageAddress());
-			cycles += 3;
-			break;
-		case 0xA3:
-			value = getMemory(getIndirectAddress());
-			cycles += 6;
-			break;
-		case 0xAF:
-			value = getMemory(getAbsoluteAddress());
-			cycles += 4;
-			break;
-		case 0xB3:
-			value = getMemory(getIndirectIndexedAddress(pageCrossed));
-			cycles += pageCrossed ? 6 : 5;
-			break;
-		case 0xB7:
-			value = getMemory((getZeroPageAddress() + Y) & 0xFF);
-			cycles += 4;
-			break;
-		case 0xBF:
-			value = getMemory(getAbsoluteIndexedAddress(Y, pageCrossed));
-			cycles += pageCrossed ? 5 : 4;
-			break;
-	}
+	uint8_t value = getMemory(addr);
 	A = value;
 	X = value;
 	updateZeroNegativeFlags(A);
 }
-void CPU::STA(uint8_t op)
+void CPU::STA(uint16_t addr)
 {
-	/*std::cout << "STA ";*/
-	uint16_t addr = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-		case 0x85:
-			addr = getZeroPageAddress();
-			cycles += 3;
-			break;
-		case 0x95:
-			addr = (getZeroPageAddress() + X) & 0xFF;
-			cycles += 4;
-			break;
-		case 0x8D:
-			addr = getAbsoluteAddress();
-			cycles += 4;
-			break;
-		case 0x9D:
-			addr = getAbsoluteAddress() + X;
-			cycles += 5;
-			break;
-		case 0x99:
-			addr = getAbsoluteAddress() + Y;
-			cycles += 5;
-			break;
-		case 0x81:
-			addr = getIndirectAddress();
-			cycles += 6;
-			break;
-		case 0x91:
-			addr = getIndirectIndexedAddress(pageCrossed);
-			cycles += 6;
-			break;
-	}
-	//std::cout << "STA: " << std::hex << static_cast<int>(A) << " to address: " << addr << std::endl;
 	setMemory(addr, A);
 }
-void CPU::STX(uint8_t op)
+void CPU::STX(uint16_t addr)
 {
-	/*std::cout << "STX ";*/
-	uint16_t addr = 0;
-	switch (op)
-	{
-	case 0x86:
-		addr = getZeroPageAddress();
-		cycles += 3;
-		break;
-	case 0x96:
-		addr = (getZeroPageAddress() + Y) & 0xFF;
-		cycles += 4;
-		break;
-	case 0x8E:
-		addr = getAbsoluteAddress();
-		cycles += 4;
-		break;
-	}
 	setMemory(addr, X);
 }
-void CPU::STY(uint8_t op)
+void CPU::STY(uint16_t addr)
 {
-	/*std::cout << "STY ";*/
-	uint16_t addr = 0;
-	switch (op)
-	{
-	case 0x84:
-		addr = getZeroPageAddress();
-		cycles += 3;
-		break;
-	case 0x94:
-		addr = (getZeroPageAddress() + X) & 0xFF;
-		cycles += 4;
-		break;
-	case 0x8C:
-		addr = getAbsoluteAddress();
-		cycles += 4;
-		break;
-	}
 	setMemory(addr, Y);
 }
-void CPU::SAX(uint8_t op)
+void CPU::SAX(uint16_t addr)
 {
-	uint8_t value = 0;
-	uint16_t addr = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-		case 0x87:
-			addr = getZeroPageAddress();
-			cycles += 3;
-			break;
-		case 0x83:
-			addr = getIndirectAddress();
-			cycles += 6;
-			break;
-		case 0x8F:
-			addr = getAbsoluteAddress();
-			cycles += 4;
-			break;
-		case 0x97:
-			addr = (getZeroPageAddress() + Y) & 0xFF;
-			cycles += 4;
-			break;
-	}
 	uint8_t result = A & X;
 	setMemory(addr, result);
 }
 
 // REGISTER TRANSFER
-void CPU::TAX()
+void CPU::TAX(uint16_t)
 {
-	/*std::cout << "TAX ";*/
 	X = A;
-	cycles += 2;
 	updateZeroNegativeFlags(X);
 }
-void CPU::TAY()
+void CPU::TAY(uint16_t)
 {
-	/*std::cout << "TAY ";*/
 	Y = A;
-	cycles += 2;
 	updateZeroNegativeFlags(Y);
 }
-void CPU::TXA()
+void CPU::TXA(uint16_t)
 {
-	/*std::cout << "TXA ";*/
 	A = X;
-	cycles += 2;
 	updateZeroNegativeFlags(A);
 }
-void CPU::TYA()
+void CPU::TYA(uint16_t)
 {
-	/*std::cout << "TYA ";*/
 	A = Y;
-	cycles += 2;
 	updateZeroNegativeFlags(A);
 }
 
 // STACK OPERATIONS
-void CPU::TSX()
+void CPU::TSX(uint16_t)
 {
-	/*std::cout << "TSX ";*/
 	X = SP;
-	cycles += 2;
 	updateZeroNegativeFlags(X);
 }
-void CPU::TXS()
+void CPU::TXS(uint16_t)
 {
-	/*std::cout << "TXS ";*/
 	SP = X;
-	cycles += 2;
 }
-void CPU::PHA()
+void CPU::PHA(uint16_t)
 {
-	/*std::cout << "PHA ";*/
 	push(A);
-	cycles += 3;
 }
-void CPU::PHP()
+void CPU::PHP(uint16_t)
 {
-	/*std::cout << "PHP ";*/
 	push(SR | 0x10);
-	cycles += 3;
 }
-void CPU::PLA()
+void CPU::PLA(uint16_t)
 {
-	/*std::cout << "PLA ";*/
 	A = pull();
-	cycles += 4;
 	updateZeroNegativeFlags(A);
 }
-void CPU::PLP() 
+void CPU::PLP(uint16_t)
 {
-	/*std::cout << "PLP ";*/
 	uint8_t value = pull();
 	SR = (value & 0xCF) | U_FLAG;
-	cycles += 4;
 }
 
 // LOGICAL OPERATIONS
-void CPU::AND(uint8_t op)
+void CPU::AND(uint16_t addr)
 {
-	uint8_t value = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-		case 0x29:
-			value = getImmediate();
-			cycles += 2;
-			break;
-		case 0x25:
-			value = getMemory(getZeroPageAddress());
-			cycles += 3;
-			break;
-		case 0x35:
-			value = getMemory((getZeroPageAddress() + X) & 0xFF);
-			cycles += 4;
-			break;
-		case 0x2D:
-			value = getMemory(getAbsoluteAddress());
-			cycles += 4;
-			break;
-		case 0x3D:
-			value = getMemory(getAbsoluteIndexedAddress(X, pageCrossed));
-			cycles += pageCrossed ? 5 : 4;
-			break;
-		case 0X39:
-			value = getMemory(getAbsoluteIndexedAddress(Y, pageCrossed));
-			cycles += pageCrossed ? 5 : 4;
-			break;
-		case 0x21:
-			value = getMemory(getIndirectAddress());
-			cycles += 6;
-			break;
-		case 0x31:
-			value = getMemory(getIndirectIndexedAddress(pageCrossed));
-			cycles += pageCrossed ? 6 : 5;
-			break;
-	}
-	A = A & value;
+	A = A & getMemory(addr);
 	updateZeroNegativeFlags(A);
 }
-void CPU::EOR(uint8_t op)
+void CPU::EOR(uint16_t addr)
 {
-	/*std::cout << "EOR ";*/
-	uint8_t value = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-		case 0x49:
-			value = getImmediate();
-			cycles += 2;
-			break;
-		case 0x45:
-			value = getMemory(getZeroPageAddress());
-			cycles += 3;
-			break;
-		case 0x55:
-			value = getMemory((getZeroPageAddress() + X) & 0xFF);
-			cycles += 4;
-			break;
-		case 0x4D:
-			value = getMemory(getAbsoluteAddress());
-			cycles += 4;
-			break;
-		case 0x5D:
-			value = getMemory(getAbsoluteIndexedAddress(X, pageCrossed));
-			cycles += pageCrossed ? 5 : 4;
-			break;
-		case 0x59:
-			value = getMemory(getAbsoluteIndexedAddress(Y, pageCrossed));
-			cycles += pageCrossed ? 5 : 4;
-			break;
-		case 0x41:
-			value = getMemory(getIndirectAddress());
-			cycles += 6;
-			break;
-		case 0x51:
-			value = getMemory(getIndirectIndexedAddress(pageCrossed));
-			cycles += pageCrossed ? 6 : 5;
-			break;
-	}
-
-	A = A ^ value;
+	A = A ^ getMemory(addr);
 	updateZeroNegativeFlags(A);
 }
-void CPU::ORA(uint8_t op)
+void CPU::ORA(uint16_t addr)
 {
-	/*std::cout << "ORA ";*/
-	uint8_t value = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-	case 0x09:
-		value = getImmediate();
-		cycles += 2;
-		break;
-	case 0x05:
-		value = getMemory(getZeroPageAddress());
-		cycles += 3;
-		break;
-	case 0x15:
-		value = getMemory((getZeroPageAddress() + X) & 0xFF);
-		cycles += 4;
-		break;
-	case 0x0D:
-		value = getMemory(getAbsoluteAddress());
-		cycles += 4;
-		break;
-	case 0x1D:
-		value = getMemory(getAbsoluteIndexedAddress(X, pageCrossed));
-		cycles += pageCrossed ? 5 : 4;
-		break;
-	case 0x19:
-		value = getMemory(getAbsoluteIndexedAddress(Y, pageCrossed));
-		cycles += pageCrossed ? 5 : 4;
-		break;
-	case 0x01:
-		value = getMemory(getIndirectAddress());
-		cycles += 6;
-		break;
-	case 0x11:
-		value = getMemory(getIndirectIndexedAddress(pageCrossed));
-		cycles += pageCrossed ? 6 : 5;
-		break;
-	}
-	//std::cout << "A = " << std::hex << static_cast<int>(A) << ", value = " << std::hex << static_cast<int>(value) << std::endl;
-	A = A | value;
+	A = A | getMemory(addr);
 	updateZeroNegativeFlags(A);
 }
-void CPU::BIT(uint8_t op)
+void CPU::BIT(uint16_t addr)
 {
-	/*std::cout << "BIT ";*/
-	uint8_t value = 0;
-	switch (op)
-	{
-		case 0x24:
-			value = getMemory(getZeroPageAddress());
-			cycles += 3;
-			break;
-		case 0x2C:
-			value = getMemory(getAbsoluteAddress());
-			cycles += 4;
-			break;
-	}
+	uint8_t value = getMemory(addr);
 	updateZeroNegativeFlags(A & value);
 	SR = (SR & ~V_FLAG) | (value & V_FLAG);
 	SR = (SR & ~N_FLAG) | (value & N_FLAG);
 }
 
 // ARITHMETIC
-void CPU::ADC(uint8_t op)
+void CPU::ADC(uint16_t addr)
 {
-	/*std::cout << "ADC ";*/
-	uint8_t value = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-	case 0x69:
-		value = getImmediate();
-		cycles += 2;
-		break;
-	case 0x65:
-		value = getMemory(getZeroPageAddress());
-		cycles += 3;
-		break;
-	case 0x75:
-		value = getMemory((getZeroPageAddress() + X) & 0xFF);
-		cycles += 4;
-		break;
-	case 0x6D:
-		value = getMemory(getAbsoluteAddress());
-		cycles += 4;
-		break;
-	case 0x7D:
-		value = getMemory(getAbsoluteIndexedAddress(X, pageCrossed));
-		cycles += pageCrossed ? 5 : 4;
-		break;
-	case 0x79:
-		value = getMemory(getAbsoluteIndexedAddress(Y, pageCrossed));
-		cycles += pageCrossed ? 5 : 4;
-		break;
-	case 0x61:
-		value = getMemory(getIndirectAddress());
-		cycles += 6;
-		break;
-	case 0x71:
-		value = getMemory(getIndirectIndexedAddress(pageCrossed));
-		cycles += pageCrossed ? 6 : 5;
-		break;
-	}
-
-	//std::cout << "A = " << std::hex << static_cast<int>(A) << ", value = " << std::hex << static_cast<int>(value) << std::endl;
-
+	uint8_t value = getMemory(addr);
 	uint8_t oldA = A;
 	uint16_t result = A + value + (SR & 0x01);
 	A = result & 0xFF;
 	updateADCFlags(oldA, value, result);
 }
-void CPU::SBC(uint8_t op)
+void CPU::SBC(uint16_t addr)
 {
-	/*std::cout << "SBC ";*/
-	uint8_t value = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-		case 0xE9:
-		case 0xEB:
-			value = getImmediate();
-			cycles += 2;
-			break;
-		case 0xE5:
-			value = getMemory(getZeroPageAddress());
-			cycles += 3;
-			break;
-		case 0xF5:
-			value = getMemory((getZeroPageAddress() + X) & 0xFF);
-			cycles += 4;
-			break;
-		case 0xED:
-			value = getMemory(getAbsoluteAddress());
-			cycles += 4;
-			break;
-		case 0xFD:
-			value = getMemory(getAbsoluteIndexedAddress(X, pageCrossed));
-			cycles += pageCrossed ? 5 : 4;
-			break;
-		case 0xF9:
-			value = getMemory(getAbsoluteIndexedAddress(Y, pageCrossed));
-			cycles += pageCrossed ? 5 : 4;
-			break;
-		case 0xE1:
-			value = getMemory(getIndirectAddress());
-			cycles += 6;
-			break;
-		case 0xF1:
-			value = getMemory(getIndirectIndexedAddress(pageCrossed));
-			cycles += pageCrossed ? 6 : 5;
-			break;
-	}
+	uint8_t value = getMemory(addr);
 	uint8_t oldA = A;
 	uint16_t result = A + ~value + (SR & C_FLAG);
 	A = result & 0xFF;
 	updateSBCFlags(oldA, value, result);
 }
-void CPU::CMP(uint8_t op)
+void CPU::CMP(uint16_t addr)
 {
-	/*std::cout << "CMP ";*/
-	uint8_t value = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-		case 0xC9:
-			value = getImmediate();
-			cycles += 2;
-			break;
-		case 0xC5:
-			value = getMemory(getZeroPageAddress());
-			cycles += 3;
-			break;
-		case 0xD5:
-			value = getMemory((getZeroPageAddress() + X) & 0xFF);
-			cycles += 4;
-			break;
-		case 0xCD:
-			value = getMemory(getAbsoluteAddress());
-			cycles += 4;
-			break;
-		case 0xDD:
-			value = getMemory(getAbsoluteIndexedAddress(X, pageCrossed));
-			cycles += pageCrossed ? 5 : 4;
-			break;
-		case 0xD9:
-			value = getMemory(getAbsoluteIndexedAddress(Y, pageCrossed));
-			cycles += pageCrossed ? 5 : 4;
-			break;
-		case 0xC1:
-			value = getMemory(getIndirectAddress());
-			cycles += 6;
-			break;
-		case 0xD1:
-			value = getMemory(getIndirectIndexedAddress(pageCrossed));
-			cycles += pageCrossed ? 6 : 5;
-			break;
-	}
-	updateCMPFlags(value, A);
+	updateCMPFlags(getMemory(addr), A);
 }
-void CPU::CPX(uint8_t op)
+void CPU::CPX(uint16_t addr)
 {
-	/*std::cout << "CPX ";*/
-	uint8_t value = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-		case 0xE0:
-			value = getImmediate();
-			cycles += 2;
-			break;
-		case 0xE4:
-			value = getMemory(getZeroPageAddress());
-			cycles += 3;
-			break;
-		case 0xEC:
-			value = getMemory(getAbsoluteAddress());
-			cycles += 4;
-			break;
-	}
-	updateCMPFlags(value, X);
+	updateCMPFlags(getMemory(addr), X);
 }
-void CPU::CPY(uint8_t op)
+void CPU::CPY(uint16_t addr)
 {
-	/*std::cout << "CPY ";*/
-	uint8_t value = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-	case 0xC0:
-		value = getImmediate();
-		cycles += 2;
-		break;
-	case 0xC4:
-		value = getMemory(getZeroPageAddress());
-		cycles += 3;
-		break;
-	case 0xCC:
-		value = getMemory(getAbsoluteAddress());
-		cycles += 4;
-		break;
-	}
-	updateCMPFlags(value, Y);
+	updateCMPFlags(getMemory(addr), Y);
 }
-void CPU::ISB(uint8_t op)
+void CPU::ISB(uint16_t addr)
 {
-	uint8_t value = 0;
-	uint16_t addr = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-		case 0xE3:
-			addr = getIndirectAddress();
-			cycles += 8;
-			break;
-		case 0xE7:
-			addr = getZeroPageAddress();
-			cycles += 5;
-			break;
-		case 0xEF:
-			addr = getAbsoluteAddress();
-			cycles += 6;
-			break;
-		case 0xF3:
-			addr = getIndirectIndexedAddress(pageCrossed);
-			cycles += pageCrossed ? 8 : 7;
-			break;
-		case 0xF7:
-			addr = (getZeroPageAddress() + X) & 0xFF;
-			cycles += 6;
-			break;
-		case 0xFB:
-			addr = getAbsoluteIndexedAddress(Y, pageCrossed);
-			cycles += pageCrossed ? 7 : 6;
-			break;
-		case 0xFF:
-			addr = getAbsoluteAddress() + X;
-			cycles += 7;
-			break;
-	}
-
-	value = getMemory(addr);
+	uint8_t value = getMemory(addr);
 	value += 1;
 	setMemory(addr, value);
 
@@ -1155,123 +620,38 @@ void CPU::ISB(uint8_t op)
 }
 
 // INCREMENTS & DECREMENTS
-void CPU::INC(uint8_t op)
+void CPU::INC(uint16_t addr)
 {
-	/*std::cout << "INC ";*/
-	uint16_t address = 0;
-	switch (op)
-	{
-		case 0xE6:
-			address = getZeroPageAddress();
-			cycles += 5;
-			break;
-		case 0xF6:
-			address = (getZeroPageAddress() + X) & 0xFF;
-			cycles += 6;
-			break;
-		case 0xEE:
-			address = getAbsoluteAddress();
-			cycles += 6;
-			break;
-		case 0xFE:
-			address = getAbsoluteAddress() + X;
-			cycles += 7;
-			break;
-	}
-
-	setMemory(address, getMemory(address) + 1);
-	updateZeroNegativeFlags(getMemory(address));
+	setMemory(addr, getMemory(addr) + 1);
+	updateZeroNegativeFlags(getMemory(addr));
 }
-void CPU::INX()
+void CPU::INX(uint16_t)
 {
-	/*std::cout << "INX ";*/
 	X += 1;
-	cycles += 2;
 	updateZeroNegativeFlags(X);
 }
-void CPU::INY()
+void CPU::INY(uint16_t)
 {
-	/*std::cout << "INY ";*/
 	Y += 1;
-	cycles += 2;
 	updateZeroNegativeFlags(Y);
 }
-void CPU::DEC(uint8_t op)
+void CPU::DEC(uint16_t addr)
 {
-	/*std::cout << "DEC ";*/
-	uint16_t address = 0;
-	switch (op)
-	{
-	case 0xC6:
-		address = getZeroPageAddress();
-		cycles += 5;
-		break;
-	case 0xD6:
-		address = (getZeroPageAddress() + X) & 0xFF;
-		cycles += 6;
-		break;
-	case 0xCE:
-		address = getAbsoluteAddress();
-		cycles += 6;
-		break;
-	case 0xDE:
-		address = getAbsoluteAddress() + X;
-		cycles += 7;
-		break;
-	}
-
-	setMemory(address, getMemory(address) - 1);
-	updateZeroNegativeFlags(getMemory(address));
+	setMemory(addr, getMemory(addr) - 1);
+	updateZeroNegativeFlags(getMemory(addr));
 }
-void CPU::DEX()
+void CPU::DEX(uint16_t)
 {
-	/*std::cout << "DEX ";*/
 	X -= 1;
-	cycles += 2;
 	updateZeroNegativeFlags(X);
 }
-void CPU::DEY()
+void CPU::DEY(uint16_t)
 {
-	/*std::cout << "DEY ";*/
 	Y -= 1;
-	cycles += 2;
 	updateZeroNegativeFlags(Y);
 }
-void CPU::DCP(uint8_t op)
+void CPU::DCP(uint16_t addr)
 {
-	uint16_t addr = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-		case 0xC3:
-			addr = getIndirectAddress();
-			cycles += 8;
-			break;
-		case 0xC7:
-			addr = getZeroPageAddress();
-			cycles += 5;
-			break;
-		case 0xCF:
-			addr = getAbsoluteAddress();
-			cycles += 6;
-			break;
-		case 0xD3:
-			addr = getIndirectIndexedAddress(pageCrossed);
-			cycles += pageCrossed ? 8 : 7;
-			break;
-		case 0xD7:
-			addr = (getZeroPageAddress() + X) & 0xFF;
-			cycles += 6;
-			break;
-		case 0xDB:
-			addr = getAbsoluteIndexedAddress(Y, pageCrossed);
-			cycles += pageCrossed ? 7 : 6;
-			break;
-		case 0xDF:
-			addr = getAbsoluteAddress() + X;
-			cycles += 7;
-			break;
-	}
 	uint8_t value = getMemory(addr);
 	value -= 1;
 	setMemory(addr, value);
@@ -1279,206 +659,58 @@ void CPU::DCP(uint8_t op)
 }
 
 // SHIFTS
-void CPU::ASL(uint8_t op) {
-	/*std::cout << "ASL ";*/
-	uint8_t value = 0;
-	uint16_t address = 0;
-	switch (op) {
-	case 0x0A:
-		value = A;
-		A = value << 1;
-		updateShiftFlags(value, A);
-		cycles += 2;
-		break;
-	case 0x06:
-		address = getZeroPageAddress();
-		value = getMemory(address);
-		setMemory(address, value << 1);
-		updateShiftFlags(value, getMemory(address));
-		cycles += 5;
-		break;
-	case 0x16:
-		address = (getZeroPageAddress() + X) & 0xFF;
-		value = getMemory(address);
-		setMemory(address, value << 1);
-		updateShiftFlags(value, getMemory(address));
-		cycles += 6;
-		break;
-	case 0x0E:
-		address = getAbsoluteAddress();
-		value = getMemory(address);
-		setMemory(address, value << 1);
-		updateShiftFlags(value, getMemory(address));
-		cycles += 6;
-		break;
-	case 0x1E:
-		address = getAbsoluteAddress() + X;
-		value = getMemory(address);
-		setMemory(address, value << 1);
-		updateShiftFlags(value, getMemory(address));
-		cycles += 7;
-		break;
-	}
+void CPU::ASL(uint16_t addr)
+{
+	uint8_t value = getMemory(addr);
+	setMemory(addr, value << 1);
+	updateShiftFlags(value, getMemory(addr));
 }
-void CPU::LSR(uint8_t op)
+void CPU::ASL_A(uint16_t)
 {
-	/*std::cout << "LSR ";*/
-	uint8_t value = 0;
-	uint16_t address = 0;
-	switch (op)
-	{
-	case 0x4A:
-		value = A;
-		A = value >> 1;
-		cycles += 2;
-		break;
-	case 0x46:
-		address = getZeroPageAddress();
-		value = getMemory(address);
-		setMemory(address, value >> 1);
-		cycles += 5;
-		break;
-	case 0x56:
-		address = (getZeroPageAddress() + X) & 0xFF;
-		value = getMemory(address);
-		setMemory(address, value >> 1);
-		cycles += 6;
-		break;
-	case 0x4E:
-		address = getAbsoluteAddress();
-		value = getMemory(address);
-		setMemory(address, value >> 1);
-		cycles += 6;
-		break;
-	case 0x5E:
-		address = getAbsoluteAddress() + X;
-		value = getMemory(address);
-		setMemory(address, value >> 1);
-		cycles += 7;
-		break;
-	}
+	uint8_t value = A;
+	A = value << 1;
+	updateShiftFlags(value, A);
+}
+void CPU::LSR(uint16_t addr)
+{
+	uint8_t value = getMemory(addr);
+	setMemory(addr, value >> 1);
 	updateLSRFlags(value, value >> 1);
 }
-void CPU::ROR(uint8_t op)
+void CPU::LSR_A(uint16_t)
 {
-	/*std::cout << "ROR ";*/
-	uint8_t value = 0;
-	uint16_t address = 0;
-	switch (op)
-	{
-		case 0x6A: 
-			value = A;
-			A = ((SR & C_FLAG) << 7) | (value >> 1);
-			cycles += 2;
-			break;
-		case 0x66: 
-			address = getZeroPageAddress();
-			value = getMemory(address);
-			setMemory(address, ((SR & C_FLAG) << 7) | (value >> 1));
-			cycles += 5;
-			break;
-		case 0x76: 
-			address = (getZeroPageAddress() + X) & 0xFF;
-			value = getMemory(address);
-			setMemory(address, ((SR & C_FLAG) << 7) | (value >> 1));
-			cycles += 6;
-			break;
-		case 0x6E: 
-			address = getAbsoluteAddress();
-			value = getMemory(address);
-			setMemory(address, ((SR & C_FLAG) << 7) | (value >> 1));
-			cycles += 6;
-			break;
-		case 0x7E:
-			address = getAbsoluteAddress() + X;
-			value = getMemory(address);
-			setMemory(address, ((SR & C_FLAG) << 7) | (value >> 1));
-			cycles += 7;
-			break;
-	}
-	updateLSRFlags(value, ((SR & C_FLAG) << 7) | (value >> 1));
+	uint8_t value = A;
+	A = value >> 1;
+	updateLSRFlags(value, value >> 1);
 }
-void CPU::ROL(uint8_t op)
+void CPU::ROR(uint16_t addr)
 {
-	/*std::cout << "ROL ";*/
-	uint8_t value = 0;
-	uint16_t address = 0;
-	switch (op)
-	{
-		case 0x2A: 
-			value = A;
-			A = (value << 1) | (SR & C_FLAG);
-			cycles += 2;
-			updateShiftFlags(value, A);
-			break;
-		case 0x26: 
-			address = getZeroPageAddress();
-			value = getMemory(address);
-			setMemory(address, (value << 1) | (SR & C_FLAG));
-			cycles += 5;
-			updateShiftFlags(value, getMemory(address));
-			break;
-		case 0x36: 
-			address = (getZeroPageAddress() + X) & 0xFF;
-			value = getMemory(address);
-			setMemory(address, (value << 1) | (SR & C_FLAG));
-			cycles += 6;
-			updateShiftFlags(value, getMemory(address));
-			break;
-		case 0x2E: 
-			address = getAbsoluteAddress();
-			value = getMemory(address);
-			setMemory(address, (value << 1) | (SR & C_FLAG));
-			cycles += 6;
-			updateShiftFlags(value, getMemory(address));
-			break;
-		case 0x3E:
-			address = getAbsoluteAddress() + X;
-			value = getMemory(address);
-			setMemory(address, (value << 1) | (SR & C_FLAG));
-			cycles += 7;
-			updateShiftFlags(value, getMemory(address));
-			break;
-	}
+	uint8_t value = getMemory(addr);
+	uint8_t result = ((SR & C_FLAG) << 7) | (value >> 1);
+	setMemory(addr, result);
+	updateLSRFlags(value, result);
 }
-void CPU::SLO(uint8_t op)
+void CPU::ROR_A(uint16_t)
 {
-	uint8_t value = 0;
-	uint16_t addr = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-		case 0x03:
-			addr = getIndirectAddress();
-			cycles += 8;
-			break;
-		case 0x07:
-			addr = getZeroPageAddress();
-			cycles += 5;
-			break;
-		case 0x0F:
-			addr = getAbsoluteAddress();
-			cycles += 6;
-			break;
-		case 0x13:
-			addr = getIndirectIndexedAddress(pageCrossed);
-			cycles += pageCrossed ? 8 : 7;
-			break;
-		case 0x17:
-			addr = (getZeroPageAddress() + X) & 0xFF;
-			cycles += 6;
-			break;
-		case 0x1B:
-			addr = getAbsoluteIndexedAddress(Y, pageCrossed);
-			cycles += pageCrossed ? 7 : 6;
-			break;
-		case 0x1F:
-			addr = getAbsoluteAddress() + X;
-			cycles += 7;
-			break;
-	}
-
-	value = getMemory(addr);
+	uint8_t value = A;
+	A = ((SR & C_FLAG) << 7) | (value >> 1);
+	updateLSRFlags(value, A);
+}
+void CPU::ROL(uint16_t addr)
+{
+	uint8_t value = getMemory(addr);
+	setMemory(addr, (value << 1) | (SR & C_FLAG));
+	updateShiftFlags(value, getMemory(addr));
+}
+void CPU::ROL_A(uint16_t)
+{
+	uint8_t value = A;
+	A = (value << 1) | (SR & C_FLAG);
+	updateShiftFlags(value, A);
+}
+void CPU::SLO(uint16_t addr)
+{
+	uint8_t value = getMemory(addr);
 	updateShiftFlags(value, value << 1);
 	value <<= 1;
 	setMemory(addr, value);
@@ -1486,88 +718,18 @@ void CPU::SLO(uint8_t op)
 	A |= value;
 	updateZeroNegativeFlags(A);
 }
-void CPU::RLA(uint8_t op)
+void CPU::RLA(uint16_t addr)
 {
-	uint8_t value = 0;
-	uint16_t addr = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-		case 0x23:
-			addr = getIndirectAddress();
-			cycles += 8;
-			break;
-		case 0x27:
-			addr = getZeroPageAddress();
-			cycles += 5;
-			break;
-		case 0x2F:
-			addr = getAbsoluteAddress();
-			cycles += 6;
-			break;
-		case 0x33:
-			addr = getIndirectIndexedAddress(pageCrossed);
-			cycles += pageCrossed ? 8 : 7;
-			break;
-		case 0x37:
-			addr = (getZeroPageAddress() + X) & 0xFF;
-			cycles += 6;
-			break;
-		case 0x3B:
-			addr = getAbsoluteIndexedAddress(Y, pageCrossed);
-			cycles += pageCrossed ? 7 : 6;
-			break;
-		case 0x3F:
-			addr = getAbsoluteAddress() + X;
-			cycles += 7;
-			break;
-	}
-
-	value = getMemory(addr);
+	uint8_t value = getMemory(addr);
 	setMemory(addr, (value << 1) | (SR & C_FLAG));
 	updateShiftFlags(value, getMemory(addr));
-	
+
 	A &= getMemory(addr);
 	updateZeroNegativeFlags(A);
 }
-void CPU::SRE(uint8_t op)
+void CPU::SRE(uint16_t addr)
 {
-	uint8_t value = 0;
-	uint16_t addr = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-		case 0x43:
-			addr = getIndirectAddress();
-			cycles += 8;
-			break;
-		case 0x47:
-			addr = getZeroPageAddress();
-			cycles += 5;
-			break;
-		case 0x4F:
-			addr = getAbsoluteAddress();
-			cycles += 6;
-			break;
-		case 0x53:
-			addr = getIndirectIndexedAddress(pageCrossed);
-			cycles += 8;
-			break;
-		case 0x57:
-			addr = (getZeroPageAddress() + X) & 0xFF;
-			cycles += 6;
-			break;
-		case 0x5B:
-			addr = getAbsoluteIndexedAddress(Y, pageCrossed);
-			cycles += 7;
-			break;
-		case 0x5F:
-			addr = getAbsoluteAddress() + X;
-			cycles += 7;
-			break;
-	}
-
-	value = getMemory(addr);
+	uint8_t value = getMemory(addr);
 	SR &= ~C_FLAG;
 	SR |= (value & 0x01);
 	value >>= 1;
@@ -1576,44 +738,9 @@ void CPU::SRE(uint8_t op)
 	A ^= value;
 	updateZeroNegativeFlags(A);
 }
-void CPU::RRA(uint8_t op)
+void CPU::RRA(uint16_t addr)
 {
-	uint8_t value = 0;
-	uint16_t addr = 0;
-	bool pageCrossed = false;
-	switch (op)
-	{
-		case 0x63:
-			addr = getIndirectAddress();
-			cycles += 8;
-			break;
-		case 0x67:
-			addr = getZeroPageAddress();
-			cycles += 5;
-			break;
-		case 0x6F:
-			addr = getAbsoluteAddress();
-			cycles += 6;
-			break;
-		case 0x73:
-			addr = getIndirectIndexedAddress(pageCrossed);
-			cycles += 8;
-			break;
-		case 0x77:
-			addr = (getZeroPageAddress() + X) & 0xFF;
-			cycles += 6;
-			break;
-		case 0x7B:
-			addr = getAbsoluteIndexedAddress(Y, pageCrossed);
-			cycles += 7;
-			break;
-		case 0x7F:
-			addr = getAbsoluteAddress() + X;
-			cycles += 7;
-			break;
-	}
-
-	value = getMemory(addr);
+	uint8_t value = getMemory(addr);
 	setMemory(addr, ((SR & C_FLAG) << 7) | (value >> 1));
 	updateLSRFlags(value, getMemory(addr));
 
@@ -1623,222 +750,106 @@ void CPU::RRA(uint8_t op)
 }
 
 // JUMPS & CALLS
-void CPU::JMP(uint8_t op)
+void CPU::JMP(uint16_t addr)
 {
-	/*std::cout << "JMP ";*/
-	switch (op)
-	{
-		case 0x4C:
-			PC = getAbsoluteAddress();
-			cycles += 3;
-			break;
-		default:
-			uint16_t pointer = getAbsoluteAddress();
-			uint8_t low = getMemory(pointer);
-			uint8_t high = getMemory((pointer & 0xFF00) | ((pointer + 1) & 0xFF));
-			PC = (static_cast<uint16_t>(high) << 8) | low;
-			cycles += 5;
-			break;
-	}
+	PC = addr;
 }
-void CPU::JSR()
+void CPU::JSR(uint16_t addr)
 {
-	/*std::cout << "JSR ";*/
-	uint16_t target = getAbsoluteAddress();
 	uint16_t ret = PC - 1;
 	push((ret >> 8) & 0xFF);
 	push(ret & 0xFF);
-	PC = target;
-	cycles += 6;
+	PC = addr;
 }
-void CPU::RTS()
+void CPU::RTS(uint16_t)
 {
-	/*std::cout << "RTS ";*/
 	uint8_t low = pull();
 	uint8_t high = pull();
 	PC = (static_cast<uint16_t>(high) << 8) | low;
 	PC++;
-	cycles += 6;
 }
 
 // BRANCHES
-void CPU::BCC()
+void CPU::BCC(uint16_t addr)
 {
-	/*std::cout << "BCC ";*/
-	int8_t offset = static_cast<int8_t>(getImmediate()); 
-	cycles += 2;
-	if (!(SR & C_FLAG)) 
-	{
-		uint16_t oldPC = PC;
-		PC += offset;
-		cycles += 1; 
-		if ((oldPC & 0xFF00) != (PC & 0xFF00)) 
-		{
-			cycles += 1;
-		}
-	}
+	branch(addr, !(SR & C_FLAG));
 }
-void CPU::BCS()
+void CPU::BCS(uint16_t addr)
 {
-	/*std::cout << "BCS ";*/
-	int8_t offset = static_cast<int8_t>(getImmediate());
-	cycles += 2;
-	if (SR & C_FLAG)
-	{
-		uint16_t oldPC = PC;
-		PC += offset;
-		cycles += 1;
-		if ((oldPC & 0xFF00) != (PC & 0xFF00))
-		{
-			cycles += 2;
-		}
-	}
+	branch(addr, SR & C_FLAG);
 }
-void CPU::BEQ()
+void CPU::BEQ(uint16_t addr)
 {
-	/*std::cout << "BEQ ";*/
-	int8_t offset = static_cast<int8_t>(getImmediate());
-	cycles += 2;
-	if (SR & Z_FLAG)
-	{
-		uint16_t oldPC = PC;
-		PC += offset;
-		cycles += 1;
-		if ((oldPC & 0xFF00) != (PC & 0xFF00))
-		{
-			cycles += 1;
-		}
-	}
+	branch(addr, SR & Z_FLAG);
 }
-void CPU::BMI()
+void CPU::BMI(uint16_t addr)
 {
-	/*std::cout << "BMI ";*/
-	int8_t offset = static_cast<int8_t>(getImmediate());
-	cycles += 2;
-	if (SR & N_FLAG)
-	{
-		uint16_t oldPC = PC;
-		PC += offset;
-		cycles += 1;
-		if ((oldPC & 0xFF00) != (PC & 0xFF00))
-		{
-			cycles += 2;
-		}
-	}
+	branch(addr, SR & N_FLAG);
 }
-void CPU::BNE()
+void CPU::BNE(uint16_t addr)
 {
-	/*std::cout << "BNE ";*/
-	int8_t offset = static_cast<int8_t>(getImmediate());
-	cycles += 2;
-	if (!(SR & Z_FLAG))
-	{
-		uint16_t oldPC = PC;
-		PC += offset;
-		cycles += 1;
-		if ((oldPC & 0xFF00) != (PC & 0xFF00))
-		{
-			cycles += 2;
-		}
-	}
+	branch(addr, !(SR & Z_FLAG));
 }
-void CPU::BPL()
+void CPU::BPL(uint16_t addr)
 {
-	/*std::cout << "BPL ";*/
-	int8_t offset = static_cast<int8_t>(getImmediate());
-	cycles += 2;
-	if (!(SR & N_FLAG))
-	{
-		uint16_t oldPC = PC;
-		PC += offset;
-		cycles += 1;
-		if ((oldPC & 0xFF00) != (PC & 0xFF00))
-		{
-			cycles += 2;
-		}
-	}
+	branch(addr, !(SR & N_FLAG));
 }
-void CPU::BVC()
+void CPU::BVC(uint16_t addr)
 {
-	/*std::cout << "BVC ";*/
-	int8_t offset = static_cast<int8_t>(getImmediate());
-	cycles += 2;
-	if (!(SR & V_FLAG))
-	{
-		uint16_t oldPC = PC;
-		PC += offset;
-		cycles += 1;
-		if ((oldPC & 0xFF00) != (PC & 0xFF00))
-		{
-			cycles += 2;
-		}
-	}
+	branch(addr, !(SR & V_FLAG));
+}
+void CPU::BVS(uint16_t addr)
+{
+	branch(addr, SR & V_FLAG);
 }
-void CPU::BVS()
+void CPU::branch(uint16_t addr, bool condition)
 {
-	/*std::cout << "BVS ";*/
-	int8_t offset = static_cast<int8_t>(getImmediate());
-	cycles += 2;
-	if (SR & V_FLAG)
+	int8_t offset = static_cast<int8_t>(getMemory(addr));
+	if (condition)
 	{
 		uint16_t oldPC = PC;
 		PC += offset;
-		cycles += 1;
+		cycles += 1; // Branch taken
 		if ((oldPC & 0xFF00) != (PC & 0xFF00))
 		{
-			cycles += 2;
+			cycles += 1; // Crossed into a new page
 		}
 	}
 }
 
 // STATUS FLAG CHANGES
-void CPU::CLC()
+void CPU::CLC(uint16_t)
 {
-	/*std::cout << "CLC ";*/
 	SR &= ~C_FLAG;
-	cycles += 2;
 }
-void CPU::CLD()
+void CPU::CLD(uint16_t)
 {
-	/*std::cout << "CLD ";*/
 	SR &= ~D_FLAG;
-	cycles += 2;
 }
-void CPU::CLI()
+void CPU::CLI(uint16_t)
 {
-	/*std::cout << "CLI ";*/
 	SR &= ~I_FLAG;
-	cycles += 2;
 }
-void CPU::CLV()
+void CPU::CLV(uint16_t)
 {
-	/*std::cout << "CLV ";*/
 	SR &= ~V_FLAG;
-	cycles += 2;
 }
-void CPU::SEC()
+void CPU::SEC(uint16_t)
 {
-	/*std::cout << "SEC ";*/
 	SR |= C_FLAG;
-	cycles += 2;
 }
-void CPU::SED()
+void CPU::SED(uint16_t)
 {
-	/*std::cout << "SED ";*/
 	SR |= D_FLAG;
-	cycles += 2;
 }
-void CPU::SEI()
+void CPU::SEI(uint16_t)
 {
-	/*std::cout << "SEI ";*/
 	SR |= I_FLAG;
-	cycles += 2;
 }
 
 // SYSTEM
-void CPU::BRK()
+void CPU::BRK(uint16_t)
 {
-	/*std::cout << "BRK ";*/
 	PC += 2;
 	SR |= B_FLAG;
 	push((PC >> 8) & 0xFF);
@@ -1846,72 +857,23 @@ void CPU::BRK()
 	push(SR);
 	PC = getMemory(0xFFFE) | (static_cast<uint16_t>(getMemory(0xFFFF)) << 8);
 	SR |= I_FLAG;
-	cycles += 7;
 }
-void CPU::NOP(uint8_t op)
+void CPU::NOP(uint16_t)
 {
-	/*std::cout << "NOP ";*/
-	bool pageCrossed = false;
-	switch (op)
-	{
-		case 0xEA: // Standard NOP
-		case 0x1A:
-		case 0x3A:
-		case 0x5A:
-		case 0x7A:
-		case 0xDA:
-		case 0xFA:
-			cycles += 2;
-			break;
-		case 0x80:
-			cycles += 2;
-			PC++;
-			break;
-		case 0x04:
-		case 0x44:
-		case 0x64:
-			cycles += 3; // Zero Page NOPs
-			PC++;
-			break;
-		case 0x0C:
-			cycles += 4;
-			PC += 2; // Absolute NOP
-			break;
-		case 0x14:
-		case 0x34:
-		case 0x54:
-		case 0x74:
-		case 0xD4:
-		case 0xF4:
-			cycles += 4; // Zero Page Indexed NOPs
-			PC++;
-			break;
-		case 0x1C:
-		case 0x3C:
-		case 0x5C:
-		case 0x7C:
-		case 0xDC:
-		case 0xFC:
-			getAbsoluteIndexedAddress(X, pageCrossed);
-			cycles += pageCrossed ? 5 : 4; // Absolute Indexed NOPs  MIGHT NEED TO ACCOUNT FOR PAGE CROSSING
-			break;
-	}
+	// Operand (if any) was consumed by the addressing mode
 }
-void CPU::RTI()
+void CPU::RTI(uint16_t)
 {
-	/*std::cout << "RTI ";*/
 	SR = pull();
 	SR &= ~B_FLAG; // Clear Break flag
 	SR |= U_FLAG; // Set Unused flag
 	uint8_t low = pull();
 	uint8_t high = pull();
 	PC = low | (static_cast<uint16_t>(high) << 8);
-	cycles += 6;
 }
-
-uint8_t CPU::getImmediate() 
+void CPU::XXX(uint16_t)
 {
-	return getMemory(PC++);
+	// Unofficial opcode that is not emulated
 }
 
 uint16_t CPU::getZeroPageAddress() 
@@ -1928,32 +890,14 @@ uint16_t CPU::getAbsoluteAddress()
 
 uint16_t CPU::getIndirectAddress()
 {
-	uint8_t zAddr = (getZeroPageAddress() + X) & 0xFF;
-	uint8_t low = getMemory(zAddr & 0xFF);
-	uint8_t high = getMemory((zAddr + 1) & 0xFF);
-	return (static_cast<uint16_t>(high) << 8) | low;
-}
-
-uint16_t CPU::getAbsoluteIndexedAddress(uint8_t index, bool& pageCrossed)
-{
-	uint8_t low = getMemory(PC++);
-	uint8_t high = getMemory(PC++);
-	uint16_t baseAddress = (static_cast<uint16_t>(high) << 8) | low;
-	uint16_t effectiveAddress = baseAddress + index;
-	pageCrossed = (baseAddress & 0xFF00) != (effectiveAddress & 0xFF00); // Compare high bytes
-	return effectiveAddress;
+	return readZeroPagePointer((getZeroPageAddress() + X) & 0xFF);
 }
 
-uint16_t CPU::getIndirectIndexedAddress(bool& pageCrossed)
+CPU::Operand CPU::indexAddress(uint16_t base, uint8_t index)
 {
-	uint8_t zAddr = getZeroPageAddress();
-	uint8_t lo = getMemory(zAddr);
-	uint8_t hi = getMemory((zAddr + 1) & 0xFF); // wrap around zero-page
-	uint16_t baseAddress = (static_cast<uint16_t>(hi) << 8) | lo;
-	uint16_t effectiveAddress = baseAddress + Y;
-
-	pageCrossed = (baseAddress & 0xFF00) != (effectiveAddress & 0xFF00);
-	return effectiveAddress;
+	uint16_t effectiveAddress = base + index;
+	bool pageCrossed = (base & 0xFF00) != (effectiveAddress & 0xFF00); // Compare high bytes
+	return { effectiveAddress, pageCrossed };
 }
 
 void CPU::updateZeroNegativeFlags(uint8_t value)
@@ -2010,18 +954,6 @@ void CPU::updateShiftFlags(uint8_t oldValue, uint8_t newValue) {
 	if (newValue & 0x80) SR |= N_FLAG; // Set Negative flag based on result
 }
 
-void CPU::push(uint8_t value)
-{
-	setMemory(0x0100 + SP, value);
-	SP = (SP - 1) & 0xFF;
-}
-
-uint8_t CPU::pull()
-{
-	SP = (SP + 1) & 0xFF;
-	return getMemory(0x0100 + SP);
-}
-
 void CPU::setMemory(uint16_t address, uint8_t value) {
 	memory->write(address, value);
 }
@@ -2030,400 +962,69 @@ uint8_t CPU::getMemory(uint16_t address) {
 	return memory->read(address);
 }
 
-std::string CPU::getOpName(uint8_t op) const
+// Mnemonics indexed by opcode, as printed in nestest logs
+static constexpr std::array<std::string_view, 256> OP_NAMES = {
+	"BRK", "ORA", "XXX", "SLO", "*NOP", "ORA", "ASL", "SLO", "PHP", "ORA", "ASL", "XXX", "*NOP", "ORA", "ASL", "SLO", // 00
+	"BPL", "ORA", "XXX", "SLO", "*NOP", "ORA", "ASL", "SLO", "CLC", "ORA", "*NOP", "SLO", "*NOP", "ORA", "ASL", "SLO", // 10
+	"JSR", "AND", "XXX", "RLA", "BIT", "AND", "ROL", "RLA", "PLP", "AND", "ROL", "XXX", "BIT", "AND", "ROL", "RLA", // 20
+	"BMI", "AND", "XXX", "RLA", "*NOP", "AND", "ROL", "RLA", "SEC", "AND", "*NOP", "RLA", "*NOP", "AND", "ROL", "RLA", // 30
+	"RTI", "EOR", "XXX", "SRE", "*NOP", "EOR", "LSR", "SRE", "PHA", "EOR", "LSR", "XXX", "JMP", "EOR", "LSR", "SRE", // 40
+	"BVC", "EOR", "XXX", "SRE", "*NOP", "EOR", "LSR", "SRE", "CLI", "EOR", "*NOP", "SRE", "*NOP", "EOR", "LSR", "SRE", // 50
+	"RTS", "ADC", "XXX", "RRA", "*NOP", "ADC", "ROR", "RRA", "PLA", "ADC", "ROR", "XXX", "JMP", "ADC", "ROR", "RRA", // 60
+	"BVS", "ADC", "XXX", "RRA", "*NOP", "ADC", "ROR", "RRA", "SEI", "ADC", "*NOP", "RRA", "*NOP", "ADC", "ROR", "RRA", // 70
+	"*NOP", "STA", "XXX", "SAX", "STY", "STA", "STX", "SAX", "DEY", "XXX", "TXA", "XXX", "STY", "STA", "STX", "SAX", // 80
+	"BCC", "STA", "XXX", "XXX", "STY", "STA", "STX", "SAX", "TYA", "STA", "TXS", "XXX", "XXX", "STA", "XXX", "XXX", // 90
+	"LDY", "LDA", "LDX", "LAX", "LDY", "LDA", "LDX", "LAX", "TAY", "LDA", "TAX", "XXX", "LDY", "LDA", "LDX", "LAX", // A0
+	"BCS", "LDA", "XXX", "LAX", "LDY", "LDA", "LDX", "LAX", "CLV", "LDA", "TSX", "XXX", "LDY", "LDA", "LDX", "LAX", // B0
+	"CPY", "CMP", "XXX", "DCP", "CPY", "CMP", "DEC", "DCP", "INY", "CMP", "DEX", "XXX", "CPY", "CMP", "DEC", "DCP", // C0
+	"BNE", "CMP", "XXX", "DCP", "*NOP", "CMP", "DEC", "DCP", "CLD", "CMP", "*NOP", "DCP", "*NOP", "CMP", "DEC", "DCP", // D0
+	"CPX", "SBC", "XXX", "ISB", "CPX", "SBC", "INC", "ISB", "INX", "SBC", "NOP", "*SBC", "CPX", "SBC", "INC", "ISB", // E0
+	"BEQ", "SBC", "XXX", "ISB", "*NOP", "SBC", "INC", "ISB", "SED", "SBC", "*NOP", "ISB", "*NOP", "SBC", "INC", "ISB", // F0
+};
+
+std::string_view CPU::getOpName(uint8_t op)
 {
-	switch (op)
-	{
-	case 0xA9: // LDA Immediate
-	case 0xA5: // LDA Zero Page
-	case 0xB5:
-	case 0xAD: // LDA Absolute
-	case 0xBD:
-	case 0xB9:
-	case 0xA1:
-	case 0xB1:
-		return "LDA";
-		break;
-	case 0xA2:
-	case 0xA6:
-	case 0xB6:
-	case 0xAE:
-	case 0xBE:
-		return "LDX";
-		break;
-	case 0xA0:
-	case 0xA4:
-	case 0xB4:
-	case 0xAC:
-	case 0xBC:
-		return "LDY";
-		break;
-	case 0x85:
-	case 0x95:
-	case 0x8D:
-	case 0x9D:
-	case 0x99:
-	case 0x81:
-	case 0x91:
-		return "STA";
-		break;
-	case 0x86:
-	case 0x96:
-	case 0x8E:
-		return "STX";
-		break;
-	case 0x84:
-	case 0x94:
-	case 0x8C:
-		return "STY";
-		break;
-	case 0xAA:
-		return "TAX";
-		break;
-	case 0xA8:
-		return "TAY";
-		break;
-	case 0x8A:
-		return "TXA";
-		break;
-	case 0x98:
-		return "TYA";
-		break;
-	case 0xBA:
-		return "TSX";
-		break;
-	case 0x9A:
-		return "TXS";
-		break;
-	case 0x48:
-		return "PHA";
-		break;
-	case 0x08:
-		return "PHP";
-		break;
-	case 0x68:
-		return "PLA";
-		break;
-	case 0x28:
-		return "PLP";
-		break;
-	case 0x29:
-	case 0x25:
-	case 0x35:
-	case 0x2D:
-	case 0x3D:
-	case 0X39:
-	case 0x21:
-	case 0x31:
-		return "AND";
-		break;
-	case 0x49:
-	case 0x45:
-	case 0x55:
-	case 0x4D:
-	case 0x5D:
-	case 0x59:
-	case 0x41:
-	case 0x51:
-		return "EOR";
-		break;
-	case 0x09:
-	case 0x05:
-	case 0x15:
-	case 0x0D:
-	case 0x1D:
-	case 0x19:
-	case 0x01:
-	case 0x11:
-		return "ORA";
-		break;
-	case 0x24:
-	case 0x2C:
-		return "BIT";
-		break;
-	case 0x69:
-	case 0x65:
-	case 0x75:
-	case 0x6D:
-	case 0x7D:
-	case 0x79:
-	case 0x61:
-	case 0x71:
-		return "ADC";
-		break;
-	case 0xE9:
-	case 0xE5:
-	case 0xF5:
-	case 0xED:
-	case 0xFD:
-	case 0xF9:
-	case 0xE1:
-	case 0xF1:
-		return "SBC";
-		break;
-	case 0xC9:
-	case 0xC5:
-	case 0xD5:
-	case 0xCD:
-	case 0xDD:
-	case 0xD9:
-	case 0xC1:
-	case 0xD1:
-		return "CMP";
-		break;
-	case 0xE0:
-	case 0xE4:
-	case 0xEC:
-		return "CPX";
-		break;
-	case 0xC0:
-	case 0xC4:
-	case 0xCC:
-		return "CPY";
-		break;
-	case 0xE6:
-	case 0xF6:
-	case 0xEE:
-	case 0xFE:
-		return "INC";
-		break;
-	case 0xE8:
-		return "INX";
-		break;
-	case 0xC8:
-		return "INY";
-		break;
-	case 0xC6:
-	case 0xD6:
-	case 0xCE:
-	case 0xDE:
-		return "DEC";
-		break;
-	case 0xCA:
-		return "DEX";
-		break;
-	case 0x88:
-		return "DEY";
-		break;
-	case 0x0A:
-	case 0x06:
-	case 0x16:
-	case 0x0E:
-	case 0x1E:
-		return "ASL";
-		break;
-	case 0x4A:
-	case 0x46:
-	case 0x56:
-	case 0x4E:
-	case 0x5E:
-		return "LSR";
-		break;
-	case 0x2A:
-	case 0x26:
-	case 0x36:
-	case 0x2E:
-	case 0x3E:
-		return "ROL";
-		break;
-	case 0x6A:
-	case 0x66:
-	case 0x76:
-	case 0x6E:
-	case 0x7E:
-		return "ROR";
-		break;
-	case 0x4C:
-	case 0x6C:
-		return "JMP";
-		break;
-	case 0x20:
-		return "JSR";
-		break;
-	case 0x60:
-		return "RTS";
-		break;
-	case 0x90:
-		return "BCC";
-		break;
-	case 0xB0:
-		return "BCS";
-		break;
-	case 0xF0:
-		return "BEQ";
-		break;
-	case 0x30:
-		return "BMI";
-		break;
-	case 0xD0:
-		return "BNE";
-		break;
-	case 0x10:
-		return "BPL";
-		break;
-	case 0x50:
-		return "BVC";
-		break;
-	case 0x70:
-		return "BVS";
-		break;
-	case 0x18:
-		return "CLC";
-		break;
-	case 0xD8:
-		return "CLD";
-		break;
-	case 0x58:
-		return "CLI";
-		break;
-	case 0xB8:
-		return "CLV";
-		break;
-	case 0x38:
-		return "SEC";
-		break;
-	case 0xF8:
-		return "SED";
-		break;
-	case 0x78:
-		return "SEI";
-		break;
-	case 0x40:
-		return "RTI";
-		break;
-	case 0xEA:
-		return "NOP";
-		break;
-	case 0x04:
-	case 0x44:
-	case 0x64:
-	case 0x0C:
-	case 0x14:
-	case 0x34:
-	case 0x54:
-	case 0x74:
-	case 0xD4:
-	case 0xF4:
-	case 0x1A:
-	case 0x3A:
-	case 0x5A:
-	case 0x7A:
-	case 0xDA:
-	case 0xFA:
-	case 0x80:
-	case 0x1C:
-	case 0x3C:
-	case 0x5C:
-	case 0x7C:
-	case 0xDC:
-	case 0xFC:
-		return "*NOP";
-		break;
-	case 0x00:
-		return "BRK";
-		break;
-	case 0xA3:
-	case 0xA7:
-	case 0xAF:
-	case 0xB3:
-	case 0xB7:
-	case 0xBF:
-		return "LAX";
-		break;
-	case 0x83:
-	case 0x87:
-	case 0x8F:
-	case 0x97:
-		return "SAX";
-		break;
-	case 0xEB:
-		return "*SBC";
-		break;
-	case 0xC3:
-	case 0xC7:
-	case 0xCF:
-	case 0xD3:
-	case 0xD7:
-	case 0xDB:
-	case 0xDF:
-		return "DCP";
-		break;
-	case 0xE3:
-	case 0xE7:
-	case 0xEF:
-	case 0xF3:
-	case 0xF7:
-	case 0xFB:
-	case 0xFF:
-		return "ISB";
-		break;
-	case 0x03:
-	case 0x07:
-	case 0x0F:
-	case 0x13:
-	case 0x17:
-	case 0x1B:
-	case 0x1F:
-		return "SLO";
-		break;
-	case 0x23:
-	case 0x27:
-	case 0x2F:
-	case 0x33:
-	case 0x37:
-	case 0x3B:
-	case 0x3F:
-		return "RLA";
-		break;
-	case 0x43:
-	case 0x47:
-	case 0x4F:
-	case 0x53:
-	case 0x57:
-	case 0x5B:
-	case 0x5F:
-		return "SRE";
-		break;
-	case 0x63:
-	case 0x67:
-	case 0x6F:
-	case 0x73:
-	case 0x77:
-	case 0x7B:
-	case 0x7F:
-		return "RRA";
-		break;
-	default:
-		return "XXX";
-		break;
-	}
+	return OP_NAMES[op];
 }
 
-void CPU::logState(std::string opName) {
+CPU::AddressingMode CPU::getAddressingMode(uint8_t op)
+{
+	return opcodeTable[op].mode;
+}
 
-	/*Format opcode bytes like "A2 00 00"*/
-	std::ostringstream opHex;
-	for (int i = 0; i < 3; ++i)
+uint8_t CPU::getOpLength(uint8_t op)
+{
+	switch (opcodeTable[op].mode)
 	{
-		//if (i < length)
-		//	opHex << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << int(opcodeBytes[i]) << " ";
-		//else
-			opHex << "   ";
+		case AddressingMode::Implied:
+		case AddressingMode::Accumulator:
+			return 1;
+		case AddressingMode::Absolute:
+		case AddressingMode::AbsoluteX:
+		case AddressingMode::AbsoluteY:
+		case AddressingMode::Indirect:
+			return 3;
+		default:
+			return 2;
 	}
+}
+
+void CPU::traceState(uint16_t pc, uint8_t op)
+{
+	// Bring the PPU up to date so the recorded scanline/dot are exact
+	ppu->catchUp();
 
-	// Format line
-	std::ostringstream line;
-	line << std::uppercase << std::hex << std::setfill(' ')
-		<< std::setw(4) << PC << "  "
-		<< opHex.str() << opName
-		<< std::left << std::setw(32) << " " << std::setfill('0')
-		<< "A:" << std::setw(2) << int(A) << " "
-		<< "X:" << std::setw(2) << int(X) << " "
-		<< "Y:" << std::setw(2) << int(Y) << " "
-		<< "P:" << std::setw(2) << int(SR | 0x20) << " "
-		<< "SP:" << std::setw(2) << int(SP) << " " << std::setfill(' ')
-		<< "PPU:" << std::right << std::setw(3) << std::dec << ppu->getScanline() << "," << std::setw(3) << ppu->getCycle() << " "
-		<< "CYC:" << std::dec << cycles;
-
-	std::cout << line.str() << std::endl;
-}
\ No newline at end of file
+	TraceRecord& rec = tracer->record();
+	rec.cycles = cycles;
+	rec.pc = pc;
+	rec.bytes[0] = op;
+	rec.bytes[1] = memory->peek(pc + 1);
+	rec.bytes[2] = memory->peek(pc + 2);
+	rec.a = A;
+	rec.x = X;
+	rec.y = Y;
+	rec.p = SR | U_FLAG;
+	rec.sp = SP;
+	rec.scanline = static_cast<uint16_t>(ppu->getScanline());
+	rec.dot = static_cast<uint16_t>(ppu->getCycle());
+}
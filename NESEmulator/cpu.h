@@ -1,11 +1,14 @@
 #pragma once
 #include <cstdint>
 #include <array>
-#include <string>
+#include <string_view>
 #include "cartridge.h"
 #include "memory.h"
 #include "ppu.h"
 #include "new_ppu.h"
+#include "trace.h"
+#include "scheduler.h"
+#include "savestate.h"
 
 class CPU
 {
@@ -13,7 +16,12 @@ public:
 	CPU(Memory* memory, PPU* ppu);
 	CPU(Memory* memory, NEW_PPU* ppu);
 	void reset();
+
+	// Trace = true records each instruction into the tracer before it
+	// executes; the untraced instantiation carries no tracing code at all
+	template<bool Trace = false>
 	void step();
+
 	void setMemory(uint16_t address, uint8_t value);
 	uint8_t getMemory(uint16_t address);
 	uint16_t getPC() const { return PC; }
@@ -22,124 +30,178 @@ public:
 	uint8_t getX() const { return X; }
 	uint8_t getY() const { return Y; }
 	uint64_t getCycles() const { return cycles; }
+	Scheduler* getScheduler() { return &scheduler; }
 	void handleNMI();
+
+	void setTracer(TraceBuffer* tracer) { this->tracer = tracer; }
+
+	// Registers, cycle count and the scheduler's pending events
+	void serialize(StateStream& state);
+
+	enum class AddressingMode : uint8_t
+	{
+		Implied, Accumulator, Immediate, Relative,
+		ZeroPage, ZeroPageX, ZeroPageY,
+		Absolute, AbsoluteX, AbsoluteY,
+		Indirect, IndirectX, IndirectY
+	};
+
+	static std::string_view getOpName(uint8_t op);
+	static AddressingMode getAddressingMode(uint8_t op);
+	static uint8_t getOpLength(uint8_t op);
 private:
 	uint8_t A, X, Y, SP, SR;
 	uint16_t PC;
 	uint64_t cycles;
-	std::array<uint8_t, 2048> ram;
-	Cartridge cartridge;
+	uint8_t* ram; // Memory's internal RAM, for zero page and stack
 	Memory* memory;
 	//PPU* ppu;
 	NEW_PPU* ppu;
-	bool nmiPending;
-	bool irqPending;
-
-	std::string opName;
+	Scheduler scheduler;
+	TraceBuffer* tracer = nullptr;
 
 	//std::array<uint8_t, 0x10000> memory;
 
 	void handleIRQ();
+	void runDMA();
 
 	void execute(uint8_t op);
 
+	// Opcode Table
+	struct Instruction
+	{
+		void (CPU::*execute)();
+		AddressingMode mode;
+		uint8_t cycles;      // Base cycle count
+		uint8_t pageCycles;  // Extra cycles when indexing crosses a page
+	};
+
+	// Effective address of an instruction's operand
+	struct Operand
+	{
+		uint16_t addr;
+		bool pageCrossed;
+	};
+
+	// One instantiation per opcode: the addressing mode, handler and
+	// cycle cost are all known at compile time and inlined together
+	template<void (CPU::*Handler)(uint16_t), AddressingMode Mode, uint8_t Cycles, uint8_t PageCycles>
+	void op();
+
+	template<AddressingMode Mode>
+	Operand fetchOperand();
+
+	template<void (CPU::*Handler)(uint16_t), AddressingMode Mode, uint8_t Cycles, uint8_t PageCycles = 0>
+	static constexpr Instruction makeInstruction();
+
+	static constexpr std::array<Instruction, 256> buildOpcodeTable();
+	static const std::array<Instruction, 256> opcodeTable;
+
 	// Load & Store
-	void LDA(uint8_t op);
-	void LDX(uint8_t op);
-	void LDY(uint8_t op);
-	void LAX(uint8_t op);
-	void STA(uint8_t op);
-	void STX(uint8_t op);
-	void STY(uint8_t op);
-	void SAX(uint8_t op);
+	void LDA(uint16_t addr);
+	void LDX(uint16_t addr);
+	void LDY(uint16_t addr);
+	void LAX(uint16_t addr);
+	void STA(uint16_t addr);
+	void STX(uint16_t addr);
+	void STY(uint16_t addr);
+	void SAX(uint16_t addr);
 
 	// Register Transfer
-	void TAX();
-	void TAY();
-	void TXA();
-	void TYA();
+	void TAX(uint16_t addr);
+	void TAY(uint16_t addr);
+	void TXA(uint16_t addr);
+	void TYA(uint16_t addr);
 
 	// Stack Operations
-	void TSX();
-	void TXS();
-	void PHA();
-	void PHP();
-	void PLA();
-	void PLP();
+	void TSX(uint16_t addr);
+	void TXS(uint16_t addr);
+	void PHA(uint16_t addr);
+	void PHP(uint16_t addr);
+	void PLA(uint16_t addr);
+	void PLP(uint16_t addr);
 
 	// Logical Operations
-	void AND(uint8_t op);
-	void EOR(uint8_t op);
-	void ORA(uint8_t op);
-	void BIT(uint8_t op);
+	void AND(uint16_t addr);
+	void EOR(uint16_t addr);
+	void ORA(uint16_t addr);
+	void BIT(uint16_t addr);
 
 	// Arithmetic
-	void ADC(uint8_t op);
-	void SBC(uint8_t op);
-	void CMP(uint8_t op);
-	void CPX(uint8_t op);
-	void CPY(uint8_t op);
-	void ISB(uint8_t op);
+	void ADC(uint16_t addr);
+	void SBC(uint16_t addr);
+	void CMP(uint16_t addr);
+	void CPX(uint16_t addr);
+	void CPY(uint16_t addr);
+	void ISB(uint16_t addr);
 
 	// Increments & Decrements
-	void INC(uint8_t op);
-	void INX();
-	void INY();
-	void DEC(uint8_t op);
-	void DEX();
-	void DEY();
-	void DCP(uint8_t op);
+	void INC(uint16_t addr);
+	void INX(uint16_t addr);
+	void INY(uint16_t addr);
+	void DEC(uint16_t addr);
+	void DEX(uint16_t addr);
+	void DEY(uint16_t addr);
+	void DCP(uint16_t addr);
 
 	// Shifts
-	void ASL(uint8_t op);
-	void LSR(uint8_t op);
-	void ROL(uint8_t op);
-	void ROR(uint8_t op);
-	void SLO(uint8_t op);
-	void RLA(uint8_t op);
-	void SRE(uint8_t op);
-	void RRA(uint8_t op);
+	void ASL(uint16_t addr);
+	void LSR(uint16_t addr);
+	void ROL(uint16_t addr);
+	void ROR(uint16_t addr);
+	void ASL_A(uint16_t addr);
+	void LSR_A(uint16_t addr);
+	void ROL_A(uint16_t addr);
+	void ROR_A(uint16_t addr);
+	void SLO(uint16_t addr);
+	void RLA(uint16_t addr);
+	void SRE(uint16_t addr);
+	void RRA(uint16_t addr);
 
 	// Jumps & Calls
-	void JMP(uint8_t op);
-	void JSR();
-	void RTS();
+	void JMP(uint16_t addr);
+	void JSR(uint16_t addr);
+	void RTS(uint16_t addr);
 
 	// Branches
-	void BCC();
-	void BCS();
-	void BEQ();
-	void BMI();
-	void BNE();
-	void BPL();
-	void BVC();
-	void BVS();
+	void BCC(uint16_t addr);
+	void BCS(uint16_t addr);
+	void BEQ(uint16_t addr);
+	void BMI(uint16_t addr);
+	void BNE(uint16_t addr);
+	void BPL(uint16_t addr);
+	void BVC(uint16_t addr);
+	void BVS(uint16_t addr);
+	void branch(uint16_t addr, bool condition);
 
 	// Status Flag Changes
-	void CLC();
-	void CLD();
-	void CLI();
-	void CLV();
-	void SEC();
-	void SED();
-	void SEI();
+	void CLC(uint16_t addr);
+	void CLD(uint16_t addr);
+	void CLI(uint16_t addr);
+	void CLV(uint16_t addr);
+	void SEC(uint16_t addr);
+	void SED(uint16_t addr);
+	void SEI(uint16_t addr);
 
 	// System Functions
-	void BRK();
-	void NOP(uint8_t op);
-	void RTI();
+	void BRK(uint16_t addr);
+	void NOP(uint16_t addr);
+	void RTI(uint16_t addr);
+	void XXX(uint16_t addr);
 
 	// Instruction Helpers
-	uint8_t getImmediate();
 	uint16_t getZeroPageAddress();
 	uint16_t getAbsoluteAddress();
 	uint16_t getIndirectAddress();
-	uint16_t getAbsoluteIndexedAddress(uint8_t index, bool& pageCrossed);
-	uint16_t getIndirectIndexedAddress(bool& pageCrossed);
+	static Operand indexAddress(uint16_t base, uint8_t index);
+
+	// Zero page and stack only ever hit internal RAM, so skip the bus
+	uint8_t readZeroPage(uint8_t addr) { return ram[addr]; }
+	uint16_t readZeroPagePointer(uint8_t addr) { return ram[addr] | (ram[(addr + 1) & 0xFF] << 8); }
 
 	// Stack Helpers
-	void push(uint8_t value);
-	uint8_t pull();
+	void push(uint8_t value) { ram[0x0100 | SP] = value; SP--; }
+	uint8_t pull() { SP++; return ram[0x0100 | SP]; }
 
 	void updateZeroNegativeFlags(uint8_t value);
 	void updateADCFlags(uint8_t oldA, uint8_t value, uint16_t result);
@@ -149,6 +211,5 @@ private:
 	void updateLSRFlags(uint8_t oldValue, uint8_t newValue);
 	void updateShiftFlags(uint8_t oldValue, uint8_t newValue);
 
-	void logState(std::string opName);
-	std::string getOpName(uint8_t op) const;
+	void traceState(uint16_t pc, uint8_t op);
 };
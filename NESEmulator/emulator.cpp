@@ -0,0 +1,163 @@
+#include "emulator.h"
+#include "hash.h"
+#include <cstring>
+
+bool Emulator::loadROM(const std::string& path)
+{
+	if (!cartridge.loadROM(path))
+	{
+		return false;
+	}
+
+	// Torn down in reverse, the CPU holds on to everything else
+	cpu.reset();
+	memory.reset();
+	apu.reset();
+	ppu.reset();
+
+	ppu = std::make_unique<NEW_PPU>(&cartridge);
+	apu = std::make_unique<APU>();
+	memory = std::make_unique<Memory>(&cartridge, ppu.get(), apu.get());
+	cpu = std::make_unique<CPU>(memory.get(), ppu.get());
+
+	frameCount = 0;
+	frameHash = {};
+	instructionCount = 0;
+
+	// The layout is fixed once the ROM is known, loads are checked against it
+	std::vector<uint8_t> state;
+	saveState(state);
+	stateSize = state.size();
+	saveSnapshot(state);
+	snapshotSize = state.size();
+	return true;
+}
+
+// Cartridge first: loading it remaps the pages the others point into
+void Emulator::serialize(StateStream& state)
+{
+	cartridge.serialize(state);
+	ppu->serialize(state);
+	apu->serialize(state);
+	memory->serialize(state);
+	cpu->serialize(state);
+	state(frameCount);
+	state(instructionCount);
+}
+
+void Emulator::saveState(std::vector<uint8_t>& state)
+{
+	save(state, true);
+}
+
+bool Emulator::loadState(const uint8_t* data, size_t size)
+{
+	return load(data, size, true);
+}
+
+void Emulator::saveSnapshot(std::vector<uint8_t>& state)
+{
+	save(state, false);
+}
+
+bool Emulator::loadSnapshot(const std::vector<uint8_t>& state)
+{
+	return load(state.data(), state.size(), false);
+}
+
+void Emulator::save(std::vector<uint8_t>& state, bool picture)
+{
+	StateHeader header = { { 'N', 'E', 'S', 'S' }, StateVersion, cartridge.getROMHash() };
+
+	state.clear();
+	StateStream stream(state);
+	stream.setPicture(picture);
+	stream(header);
+	serialize(stream);
+}
+
+bool Emulator::load(const uint8_t* data, size_t size, bool picture)
+{
+	StateHeader header;
+	if (size != (picture ? stateSize : snapshotSize) || size < sizeof(header))
+	{
+		return false;
+	}
+
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.magic, "NESS", 4) != 0 || header.version != StateVersion || header.romHash != cartridge.getROMHash())
+	{
+		return false;
+	}
+
+	StateStream stream(data + sizeof(header), size - sizeof(header));
+	stream.setPicture(picture);
+	serialize(stream);
+	return stream.ok();
+}
+
+bool Emulator::endFrame()
+{
+	if (!ppu->isFrameComplete())
+	{
+		return false;
+	}
+
+	ppu->resetFrameComplete();
+	frameCount++;
+
+	// The frame's audio is complete before the frontend looks at it
+	apu->catchUp();
+
+	if (frameHashing)
+	{
+		uint64_t video = hash64(ppu->getFrameBuffer(), 256 * 240);
+		frameHash.frame = frameCount;
+		frameHash.video = hash64(ppu->getLineEmphasis(), 240, video);
+		frameHash.ram = hash64(memory->getRAM(), 2048);
+	}
+	return true;
+}
+
+// PPU catch-up, NMI and DMA are run from the CPU's scheduler, so this is
+// the whole machine
+template<bool Trace>
+void Emulator::runFrame()
+{
+	CPU& cpu = *this->cpu;
+	uint64_t instructions = 0;
+
+	while (!ppu->isFrameComplete())
+	{
+		cpu.step<Trace>();
+		instructions++;
+	}
+
+	instructionCount += instructions;
+	endFrame();
+}
+
+template<bool Trace>
+bool Emulator::runScanline()
+{
+	CPU& cpu = *this->cpu;
+
+	// The PPU only runs on demand, bring it up to date to see where the
+	// line ends. Dots left in the line, rounded up to CPU cycles
+	ppu->catchUp();
+	int dots = 342 - ppu->getCycle();
+	uint64_t lineEnd = cpu.getCycles() + (dots + 2) / 3;
+
+	while (cpu.getCycles() < lineEnd && !ppu->isFrameComplete())
+	{
+		cpu.step<Trace>();
+		instructionCount++;
+	}
+
+	return endFrame();
+}
+
+template void Emulator::runFrame<false>();
+template void Emulator::runFrame<true>();
+template bool Emulator::runScanline<false>();
+template bool Emulator::runScanline<true>();
@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "cartridge.h"
+#include "new_ppu.h"
+#include "apu.h"
+#include "memory.h"
+#include "cpu.h"
+
+// One NES: the cartridge plus the components wired to it. Frontends
+// drive it a frame (or a scanline) at a time and handle input and
+// presentation in between, never per instruction
+class Emulator
+{
+public:
+	Emulator() = default;
+	Emulator(const Emulator&) = delete;
+	Emulator& operator=(const Emulator&) = delete;
+
+	// Loads the ROM and powers the machine on. The CPU reads its reset
+	// vector on construction, so everything but the cartridge is built here
+	bool loadROM(const std::string& path);
+
+	// Runs until the PPU finishes the current frame
+	template<bool Trace = false>
+	void runFrame();
+
+	// Runs to about the end of the current scanline, for frontends that
+	// poll input more often than once per frame. Returns true if the
+	// frame completed along the way
+	template<bool Trace = false>
+	bool runScanline();
+
+	// Save states: a header (magic, version, ROM hash) followed by each
+	// component's fields. saveState replaces the buffer's contents but
+	// keeps its capacity, so saving into the same buffer never allocates.
+	// loadState leaves the machine untouched if the state doesn't match
+	// this version and ROM
+	static constexpr uint32_t StateVersion = 2;
+	void saveState(std::vector<uint8_t>& state);
+	bool loadState(const uint8_t* data, size_t size);
+	bool loadState(const std::vector<uint8_t>& state) { return loadState(state.data(), state.size()); }
+	size_t getStateSize() const { return stateSize; }
+
+	// The same without the picture, for keeping many states as rewind
+	// does. Loading one leaves the current picture on screen until the
+	// next frame replaces it
+	void saveSnapshot(std::vector<uint8_t>& state);
+	bool loadSnapshot(const std::vector<uint8_t>& state);
+	size_t getSnapshotSize() const { return snapshotSize; }
+
+	// Hashes of the picture (frame buffer and per-line emphasis) and of
+	// CPU RAM, taken as each frame completes, for checking a run against
+	// a known good one without keeping the frames. Off by default
+	struct FrameHash
+	{
+		uint64_t frame; // Frame count once the frame completed
+		uint64_t video;
+		uint64_t ram;
+	};
+	void setFrameHashing(bool enabled) { frameHashing = enabled; }
+	const FrameHash& getFrameHash() const { return frameHash; }
+
+	uint64_t getFrameCount() const { return frameCount; }
+	uint64_t getInstructionCount() const { return instructionCount; }
+
+	Cartridge& getCartridge() { return cartridge; }
+	NEW_PPU& getPPU() { return *ppu; }
+	APU& getAPU() { return *apu; }
+	Memory& getMemory() { return *memory; }
+	CPU& getCPU() { return *cpu; }
+	Controller& getController(int port) { return memory->getController(port); }
+
+private:
+	Cartridge cartridge;
+	std::unique_ptr<NEW_PPU> ppu;
+	std::unique_ptr<APU> apu;
+	std::unique_ptr<Memory> memory;
+	std::unique_ptr<CPU> cpu;
+
+	uint64_t frameCount = 0;
+	uint64_t instructionCount = 0;
+	size_t stateSize = 0;    // Bytes in a save state of the loaded ROM
+	size_t snapshotSize = 0; // And in one without the picture
+
+	bool frameHashing = false;
+	FrameHash frameHash = {};
+
+	struct StateHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t romHash;
+	};
+
+	void serialize(StateStream& state);
+	void save(std::vector<uint8_t>& state, bool picture);
+	bool load(const uint8_t* data, size_t size, bool picture);
+
+	// Counts the frame if the PPU just finished one
+	bool endFrame();
+};
@@ -0,0 +1,102 @@
+#include "hash.h"
+#include <array>
+#include <cstring>
+
+static const uint64_t Prime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t Prime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t Prime3 = 0x165667B19E3779F9ULL;
+static const uint64_t Prime32 = 0x9E3779B1ULL;
+
+static const int Lanes = 8;
+static const size_t StripeBytes = Lanes * 8;
+static const int StripesPerBlock = 16;
+
+// Stripe n of a block is keyed with words n to n + 7, the scramble at the
+// end of a block with the last Lanes words
+static constexpr std::array<uint64_t, StripesPerBlock + 2 * Lanes> makeSecret()
+{
+	std::array<uint64_t, StripesPerBlock + 2 * Lanes> secret = {};
+	uint64_t state = Prime3;
+	for (uint64_t& word : secret)
+	{
+		// splitmix64
+		state += 0x9E3779B97F4A7C15ULL;
+		uint64_t z = state;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		word = z ^ (z >> 31);
+	}
+	return secret;
+}
+
+static constexpr auto secret = makeSecret();
+
+static inline uint64_t rotl(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+static inline void accumulate(uint64_t* acc, const uint8_t* stripe, const uint64_t* key)
+{
+	uint64_t value[Lanes];
+	std::memcpy(value, stripe, StripeBytes);
+	for (int i = 0; i < Lanes; i += 2)
+	{
+		uint64_t keyed0 = value[i] ^ key[i];
+		uint64_t keyed1 = value[i + 1] ^ key[i + 1];
+		acc[i] += value[i + 1] + (keyed0 & 0xFFFFFFFF) * (keyed0 >> 32);
+		acc[i + 1] += value[i] + (keyed1 & 0xFFFFFFFF) * (keyed1 >> 32);
+	}
+}
+
+static inline void scramble(uint64_t* acc, const uint64_t* key)
+{
+	for (int i = 0; i < Lanes; i++)
+	{
+		acc[i] ^= acc[i] >> 47;
+		acc[i] ^= key[i];
+		acc[i] *= Prime32;
+	}
+}
+
+static inline uint64_t avalanche(uint64_t h)
+{
+	h ^= h >> 37;
+	h *= Prime3;
+	h ^= h >> 32;
+	return h;
+}
+
+uint64_t hash64(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* input = static_cast<const uint8_t*>(data);
+	uint64_t acc[Lanes] = { Prime32, Prime1, Prime2, Prime3, Prime1 ^ Prime2, Prime32 ^ Prime3, Prime2 + Prime3, ~Prime32 };
+	for (uint64_t& lane : acc)
+		lane += seed;
+
+	// Every stripe but the last, which may be partial
+	size_t stripes = size > 0 ? (size - 1) / StripeBytes : 0;
+	size_t stripe = 0;
+	for (; stripe + StripesPerBlock <= stripes; stripe += StripesPerBlock)
+	{
+		for (int n = 0; n < StripesPerBlock; n++)
+			accumulate(acc, input + (stripe + n) * StripeBytes, &secret[n]);
+		scramble(acc, &secret[StripesPerBlock + Lanes]);
+	}
+	for (int n = 0; stripe < stripes; stripe++, n++)
+		accumulate(acc, input + stripe * StripeBytes, &secret[n]);
+
+	// The last 64 bytes, overlapping the stripe before when the size
+	// isn't a multiple, or zero padded when there aren't 64
+	uint8_t last[StripeBytes] = {};
+	if (size >= StripeBytes)
+		std::memcpy(last, input + size - StripeBytes, StripeBytes);
+	else if (size > 0)
+		std::memcpy(last, input, size);
+	accumulate(acc, last, &secret[StripesPerBlock]);
+
+	uint64_t h = size * Prime1 ^ seed;
+	for (int i = 0; i < Lanes; i++)
+		h = rotl(h ^ avalanche(acc[i] ^ secret[i]), 27) * Prime1 + Prime2;
+	return avalanche(h);
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Fast non-cryptographic 64-bit hash laid out like XXH3: eight 64-bit
+// lanes, each taking a 32x32 multiply of 8 input bytes against a secret,
+// so the inner loop maps straight onto SIMD. Output is not XXH3's, it is
+// only meant to be compared against hashes from this emulator
+uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
@@ -0,0 +1,34 @@
+#include "input.h"
+
+void Controller::write(uint8_t value)
+{
+	strobe = value & 0x01;
+	if (strobe)
+	{
+		shift = buttons;
+	}
+}
+
+uint8_t Controller::read()
+{
+	// While strobed the register keeps reloading, so only A is visible
+	if (strobe)
+	{
+		shift = buttons;
+	}
+
+	uint8_t bit = shift & 0x01;
+
+	// Official controllers read 1 once all eight buttons are out
+	shift = (shift >> 1) | 0x80;
+
+	// Upper bits are open bus, usually $40 from the high byte of $4016
+	return 0x40 | bit;
+}
+
+void Controller::serialize(StateStream& state)
+{
+	state(buttons);
+	state(shift);
+	state(strobe);
+}
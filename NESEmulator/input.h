@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include "savestate.h"
+
+// Button bits, in the order the controller shifts them out
+enum Button : uint8_t
+{
+	ButtonA      = 0x01,
+	ButtonB      = 0x02,
+	ButtonSelect = 0x04,
+	ButtonStart  = 0x08,
+	ButtonUp     = 0x10,
+	ButtonDown   = 0x20,
+	ButtonLeft   = 0x40,
+	ButtonRight  = 0x80
+};
+
+// Standard controller on $4016/$4017. Buttons are latched into a shift
+// register while the strobe bit of $4016 is high and read out one bit
+// per read once it goes low
+class Controller
+{
+public:
+	// Buttons currently held, set by the frontend between frames
+	void setButtons(uint8_t buttons) { this->buttons = buttons; }
+	uint8_t getButtons() const { return buttons; }
+
+	void write(uint8_t value);
+	uint8_t read();
+
+	void serialize(StateStream& state);
+
+private:
+	uint8_t buttons = 0;
+	uint8_t shift = 0;
+	bool strobe = false;
+};
@@ -1,26 +1,92 @@
 #include <iostream>
 #include <iomanip>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <atomic>
 #include <SDL.h>
-#include "cpu.h"
-#include "cartridge.h"
-#include "memory.h"
+#include "emulator.h"
 #include "ppu.h"
-#include "new_ppu.h"
-#include "apu.h"
+#include "palette.h"
+#include "trace.h"
+#include "triple_buffer.h"
+#include "rewind.h"
+#include "movie.h"
+#include "blep.h"
+#include "ring_buffer.h"
 
 using namespace std;
 
 void renderFrame(SDL_Renderer* renderer, SDL_Texture* screenTex, uint32_t* frameBuffer);
-void viewNametable(SDL_Renderer* renderer, SDL_Texture* screenTex, NEW_PPU& ppu, uint16_t base);
+void viewNametable(const Cartridge& cartridge, uint16_t base, uint8_t* pixels);
+int runBenchmark(const char* romPath, int frames, bool trace, NEW_PPU::RenderMode renderMode);
+
+// A finished frame as the core hands it to the SDL thread
+struct VideoFrame
+{
+    std::array<uint8_t, 256 * 240> pixels;
+    std::array<uint8_t, 240> emphasis;
+};
+
+// Requests from the SDL thread, picked up by the core between frames
+struct CoreControl
+{
+    std::atomic<bool> running = true;
+    std::atomic<bool> tracing = false;
+    std::atomic<bool> saveTrace = false;
+    std::atomic<bool> toggleRenderMode = false;
+    std::atomic<bool> saveState = false;
+    std::atomic<bool> loadState = false;
+    std::atomic<bool> rewinding = false;
+    std::atomic<bool> toggleRecording = false;
+    std::atomic<int> patternTable = -1; // Shown instead of the picture, -1 for none
+    std::atomic<uint8_t> buttons = 0; // Controller 1
+};
+
+// Output format, and what the core queues for the audio callback
+const int AudioRate = 48000;
+using AudioQueue = RingBuffer<int16_t>;
+
+// Queue level the core steers towards, about 43 ms
+const size_t AudioLatency = 2048;
+
+void runCore(Emulator& emulator, CoreControl& control, TripleBuffer<VideoFrame>& frames, AudioQueue* audio);
+void audioCallback(void* userdata, Uint8* stream, int len);
+int dumpTrace(const char* tracePath);
 
 int main(int argc, char* argv[])
 {
+    // Usage: NESEmulator --bench <rom> [frames] [--trace] [--scanline]
+    if (argc >= 3 && std::string(argv[1]) == "--bench")
+    {
+        bool trace = false;
+        NEW_PPU::RenderMode renderMode = NEW_PPU::RenderMode::Dot;
+        for (int i = 4; i < argc; i++)
+        {
+            if (std::string(argv[i]) == "--trace")
+                trace = true;
+            else if (std::string(argv[i]) == "--scanline")
+                renderMode = NEW_PPU::RenderMode::Scanline;
+        }
+        return runBenchmark(argv[2], argc >= 4 ? std::stoi(argv[3]) : 600, trace, renderMode);
+    }
+
+    // Usage: NESEmulator --dump-trace <trace.bin>
+    if (argc >= 3 && std::string(argv[1]) == "--dump-trace")
+    {
+        return dumpTrace(argv[2]);
+    }
+
     // Value determines size of window
     int scale = 3;
 	bool viewNametable0 = false;
 	bool viewNametable1 = false;
+    bool tracing = false;
 
-    if (SDL_Init(SDL_INIT_VIDEO) < 0)
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0)
     {
         std::cout << "Failed to initialize the SDL2 library\n";
         return -1;
@@ -38,9 +104,10 @@ int main(int argc, char* argv[])
         return -1;
     }
 
+    // No vsync: the core paces itself, and presenting never blocks
+    // waiting for a display that doesn't run at the NES frame rate
     SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, 
-                                                SDL_RENDERER_ACCELERATED | 
-                                                SDL_RENDERER_PRESENTVSYNC);
+                                                SDL_RENDERER_ACCELERATED);
 
     if (!renderer)
     {
@@ -75,26 +142,54 @@ int main(int argc, char* argv[])
     }
 
     // NES COMPONENTS
-    Cartridge cartridge;
+    // Cartridge, PPU, APU, RAM and CPU, wired together by the emulator
+    Emulator emulator;
 
-    if (!cartridge.loadROM("../ROMS/DK.nes"))
+    if (!emulator.loadROM("../ROMS/DK.nes"))
     {
         std::cout << "ROM not loaded.\n";
         return -1;
     }
 
-    // Cartridge is passed to the PPU and RAM both for memory purposes
-    // PPU contains VRAM and CPU has no onboard memory
-    // Cartridge contains some onboard memory as well
-    
-    //PPU ppu(&cartridge);
-    NEW_PPU ppu(&cartridge);
+    // The core runs on its own thread and hands finished frames over
+    // through the triple buffer, this thread only handles input and
+    // presents whatever frame is newest. Three frames are too big to sit
+    // on this thread's stack next to frameBuffer
+    CoreControl control;
+    auto frames = std::make_unique<TripleBuffer<VideoFrame>>();
+
+    // The core writes samples as it finishes each frame and SDL's audio
+    // thread pulls them, the queue holds a little over 150 ms
+    AudioQueue audio(8192);
+
+    SDL_AudioSpec want = {};
+    want.freq = AudioRate;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = 512;
+    want.callback = audioCallback;
+    want.userdata = &audio;
+
+    SDL_AudioDeviceID audioDevice = SDL_OpenAudioDevice(nullptr, 0, &want, nullptr, 0);
+    if (audioDevice == 0)
+    {
+        std::cout << "No audio: " << SDL_GetError() << "\n";
+    }
+
+    std::thread core(runCore, std::ref(emulator), std::ref(control), std::ref(*frames), audioDevice != 0 ? &audio : nullptr);
 
-    APU apu;
+    if (audioDevice != 0)
+    {
+        SDL_PauseAudioDevice(audioDevice, 0);
+    }
 
-    Memory memory(&cartridge, &ppu, &apu);
-    // Has access to RAM and minimal access to PPU
-    CPU cpu(&memory, &ppu);
+    // Keyboard layout for controller 1
+    const std::pair<SDL_Scancode, uint8_t> keyMap[] = {
+        { SDL_SCANCODE_X, ButtonA }, { SDL_SCANCODE_Z, ButtonB },
+        { SDL_SCANCODE_RSHIFT, ButtonSelect }, { SDL_SCANCODE_RETURN, ButtonStart },
+        { SDL_SCANCODE_UP, ButtonUp }, { SDL_SCANCODE_DOWN, ButtonDown },
+        { SDL_SCANCODE_LEFT, ButtonLeft }, { SDL_SCANCODE_RIGHT, ButtonRight }
+    };
 
     // Main render loop
     while (keep_window_open)
@@ -113,13 +208,35 @@ int main(int argc, char* argv[])
                         case SDLK_F1:
                             viewNametable0 = !viewNametable0;
                             viewNametable1 = false;
+                            control.patternTable = viewNametable0 ? 0 : -1;
 							cout << "Nametable 0" << (viewNametable0 ? " enabled" : " disabled") << endl;
 							break;
                         case SDLK_F2:
                             viewNametable1 = !viewNametable1;
                             viewNametable0 = false;
+                            control.patternTable = viewNametable1 ? 1 : -1;
 							cout << "Nametable 1" << (viewNametable1 ? " enabled" : " disabled") << endl;
 							break;
+                        case SDLK_F3:
+                            tracing = !tracing;
+                            control.tracing = tracing;
+                            cout << "Trace" << (tracing ? " enabled" : " disabled") << endl;
+                            break;
+                        case SDLK_F4:
+                            control.saveTrace = true;
+                            break;
+                        case SDLK_F5:
+                            control.toggleRenderMode = true;
+                            break;
+                        case SDLK_F6:
+                            control.saveState = true;
+                            break;
+                        case SDLK_F7:
+                            control.loadState = true;
+                            break;
+                        case SDLK_F8:
+                            control.toggleRecording = true;
+                            break;
                         default:
                             break;
 					}
@@ -128,31 +245,41 @@ int main(int argc, char* argv[])
             }
         }
 
-        // One CPU operation
-        // Triggers PPU step internally, 1 CPU step = 3 PPU Steps
-        cpu.step();
-
-        if (ppu.getNMI())
+        // Sampled once per pass, the core applies it at its next frame
+        const Uint8* keys = SDL_GetKeyboardState(nullptr);
+        uint8_t buttons = 0;
+        for (const auto& [key, button] : keyMap)
         {
-            cpu.handleNMI();
+            if (keys[key])
+                buttons |= button;
         }
+        control.buttons = buttons;
+        control.rewinding = keys[SDL_SCANCODE_BACKSPACE] != 0;
 
-        // Frame rendered to screen after being marked as complete
-        if (viewNametable0)
-        {
-            viewNametable(renderer, screenTex, ppu, 0x0000);
-        }
-        else if (viewNametable1)
+        // Without vsync presenting doesn't wait, so the picture is
+        // redrawn only when the core has finished another frame. The
+        // pattern table views come through the same way
+        if (frames->update())
         {
-            viewNametable(renderer, screenTex, ppu, 0x1000);
+            // The PPU's frame is indexed, convert it for the texture
+            const VideoFrame& frame = frames->front();
+            convertFrame(frame.pixels.data(), frame.emphasis.data(), frameBuffer.data());
+            renderFrame(renderer, screenTex, frameBuffer.data());
         }
-        else if (ppu.isFrameComplete())
+        else
         {
-            renderFrame(renderer, screenTex, ppu.getFrameBuffer());
-            //renderFrame(renderer, screenTex, const_cast<uint32_t*>(frameBuffer.data()));
-            ppu.resetFrameComplete();
+            SDL_Delay(1);
         }
     }
+
+    control.running = false;
+    core.join();
+
+    if (audioDevice != 0)
+    {
+        SDL_CloseAudioDevice(audioDevice);
+    }
+
     SDL_DestroyTexture(screenTex);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
@@ -166,29 +293,13 @@ void renderFrame(SDL_Renderer* renderer, SDL_Texture* screenTex, uint32_t* frame
 	SDL_RenderPresent(renderer);
 }
 
-static const uint32_t palette[64] = {
-    0x545454FF, 0x001E74FF, 0x081090FF, 0x300088FF,
-    0x440064FF, 0x5C0030FF, 0x540400FF, 0x3C1800FF,
-    0x202A00FF, 0x083A00FF, 0x003C00FF, 0x003A10FF,
-    0x002840FF, 0x000000FF, 0x000000FF, 0x000000FF,
-    0x989898FF, 0x084CC4FF, 0x3032ECFF, 0x5C1EE4FF,
-    0x8814B0FF, 0xA01464FF, 0x982220FF, 0x783C00FF,
-    0x545A00FF, 0x287200FF, 0x087C00FF, 0x007628FF,
-    0x006678FF, 0x000000FF, 0x000000FF, 0x000000FF,
-    0xECECECFF, 0x4C9AEFFF, 0x787CFFFF, 0xB062FFFF,
-    0xE454E4FF, 0xFC58B8FF, 0xF87858FF, 0xFCA044FF,
-    0xF0C000FF, 0xA0D800FF, 0x48E400FF, 0x00CC44FF,
-    0x00B4CCFF, 0x3C3C3CFF, 0x000000FF, 0x000000FF,
-    0xECECECFF, 0xA8D8F8FF, 0xB8B8FFFF, 0xD8B8F8FF,
-    0xF8B8F8FF, 0xF8B8D8FF, 0xF8C8B8FF, 0xF0D8A8FF,
-    0xF0E4A0FF, 0xC8F0A0FF, 0xA8F0B8FF, 0xB8F8B8FF,
-    0xB8F8D8FF, 0x787878FF, 0x000000FF, 0x000000FF
-};
-
-void viewNametable(SDL_Renderer* renderer, SDL_Texture* screenTex, NEW_PPU& ppu, uint16_t base)
+// Draws a pattern table into an indexed frame, for the core thread to
+// publish in place of the picture. Pixel values 0-3 come out as the
+// first four NES colors
+void viewNametable(const Cartridge& cartridge, uint16_t base, uint8_t* pixels)
 {
-    std::array<uint32_t, 256 * 240> frameBuffer;
     const int tilesPerRow = 16;
+    std::fill_n(pixels, 256 * 240, 0x0F); // Black around the tiles
 
     for (int i = 0; i < 256; i++)
     {
@@ -198,27 +309,293 @@ void viewNametable(SDL_Renderer* renderer, SDL_Texture* screenTex, NEW_PPU& ppu,
         uint16_t tileAddr = base + i * 16;
 
         for (int row = 0; row < 8; ++row) {
-            uint8_t plane0 = ppu.readVRAM(tileAddr + row);
-            uint8_t plane1 = ppu.readVRAM(tileAddr + row + 8);
-
-            for (int col = 0; col < 8; ++col) {
-                uint8_t bit0 = (plane0 >> (7 - col)) & 1;
-                uint8_t bit1 = (plane1 >> (7 - col)) & 1;
-                uint8_t pixel = (bit1 << 1) | bit0;
-
-                // Map to a debug grayscale palette: 03
-                uint32_t color = palette[pixel];
-                
-                // Calculate the position in the framebuffer
-                int x = tileX + col;
-                int y = tileY + row;
-                if (x < 256 && y < 240) {
-                    frameBuffer[y * 256 + x] = color;
-                }
+            // Tiles are already decoded, so a whole row is copied at once
+            const uint8_t* tile = cartridge.getTileRow(tileAddr + row);
+            uint8_t* dest = &pixels[(tileY + row) * 256 + tileX];
+
+            for (int col = 0; col < 8; ++col)
+                dest[col] = tile[col];
+        }
+    }
+}
+
+// SDL audio thread: plays what the core has queued. If the core falls
+// behind, the last sample is held so the gap doesn't click, and playback
+// waits for the queue to fill back up before starting again
+void audioCallback(void* userdata, Uint8* stream, int len)
+{
+    static int16_t last = 0;
+    static bool playing = false;
+
+    AudioQueue& audio = *static_cast<AudioQueue*>(userdata);
+    int16_t* out = reinterpret_cast<int16_t*>(stream);
+    size_t count = len / sizeof(int16_t);
+
+    size_t read = 0;
+    if (playing || audio.size() >= AudioLatency)
+    {
+        read = audio.read(out, count);
+        playing = read == count;
+    }
+    if (read > 0)
+        last = out[read - 1];
+    std::fill(out + read, out + count, last);
+}
+
+// Emulation thread: runs whole frames and publishes each one, paced to
+// the NES frame rate rather than to the display. With audio the frames'
+// samples are queued as well, and the queue's level steers the pacing
+void runCore(Emulator& emulator, CoreControl& control, TripleBuffer<VideoFrame>& frames, AudioQueue* audio)
+{
+    // 60.0988 Hz, the NTSC frame rate
+    const std::chrono::nanoseconds framePeriod(16639267);
+
+    CPU& cpu = emulator.getCPU();
+    NEW_PPU& ppu = emulator.getPPU();
+
+    // Allocated on first use, keeps the last 4M instructions
+    std::unique_ptr<TraceBuffer> tracer;
+
+    // Quick save slot, kept in memory only
+    std::vector<uint8_t> savedState;
+
+    // A snapshot at the start of every frame along with the buttons the
+    // frame ran with, up to ten minutes of them. Most frames change a few
+    // hundred bytes, so 8 MB holds several minutes even of a busy game.
+    // Backspace steps back through them one frame at a time
+    RewindBuffer rewind(emulator.getSnapshotSize(), 8 << 20, 10 * 60 * 60);
+    std::vector<uint8_t> rewindState;
+    rewindState.reserve(emulator.getSnapshotSize());
+
+    // F8 starts and stops recording input to movie.nesm
+    Movie movie;
+    bool recording = false;
+    auto stopRecording = [&]()
+    {
+        recording = false;
+        if (movie.save("movie.nesm"))
+            cout << "Saved " << movie.getFrameCount() << " frames to movie.nesm" << endl;
+    };
+
+    // The APU's output changes become samples at the output rate
+    BlepSynth synth(1789773, AudioRate);
+    std::vector<int16_t> samples(AudioRate / 10);
+    if (audio)
+        emulator.getAPU().setAudioSink(&synth);
+
+    // The sound card's clock and ours never quite agree, so the output
+    // rate is nudged by up to 0.5% to hold the queue at AudioLatency.
+    // Well under what anyone hears as a pitch change. The slow part of
+    // the nudge learns the steady difference between the clocks, so the
+    // queue settles at its level instead of short of it
+    const double maxRateChange = 0.005;
+    double rateDrift = 0;
+
+    auto nextFrame = std::chrono::steady_clock::now();
+    while (control.running)
+    {
+        bool tracing = control.tracing;
+        if (tracing && !tracer)
+        {
+            tracer = std::make_unique<TraceBuffer>(1 << 22);
+            cpu.setTracer(tracer.get());
+        }
+        if (control.saveTrace.exchange(false) && tracer && tracer->save("trace.bin"))
+        {
+            cout << "Saved " << tracer->size() << " trace records to trace.bin" << endl;
+        }
+        if (control.toggleRenderMode.exchange(false))
+        {
+            bool scanline = ppu.getRenderMode() == NEW_PPU::RenderMode::Dot;
+            ppu.catchUp();
+            ppu.setRenderMode(scanline ? NEW_PPU::RenderMode::Scanline : NEW_PPU::RenderMode::Dot);
+            cout << "Render mode: " << (scanline ? "scanline" : "dot") << endl;
+        }
+        if (control.saveState.exchange(false))
+        {
+            emulator.saveState(savedState);
+            cout << "State saved" << endl;
+        }
+        if (control.loadState.exchange(false) && emulator.loadState(savedState))
+        {
+            cout << "State loaded" << endl;
+            synth.setTime(cpu.getCycles());
+
+            // The movie can't follow a jump to another point in time
+            if (recording)
+                stopRecording();
+        }
+        if (control.toggleRecording.exchange(false))
+        {
+            if (recording)
+            {
+                stopRecording();
+            }
+            else
+            {
+                movie.startRecording(emulator);
+                recording = true;
+                cout << "Recording movie" << endl;
+            }
+        }
+
+        uint8_t buttons = control.buttons;
+        emulator.getController(0).setButtons(buttons);
+
+        if (control.rewinding)
+        {
+            // Stays on the oldest frame once the history runs out
+            uint8_t input;
+            if (rewind.pop(rewindState, input))
+            {
+                // Snapshots carry no picture. Running the frame again with
+                // the buttons it had redraws it, and loading the snapshot
+                // again keeps that picture. Lines drawn with rendering off
+                // show the backdrop rather than a later frame's pixels.
+                // Silent, the sound was heard already
+                emulator.loadSnapshot(rewindState);
+                ppu.clearPicture();
+                emulator.getController(0).setButtons(input);
+                emulator.getAPU().setAudioSink(nullptr);
+                emulator.runFrame();
+                emulator.loadSnapshot(rewindState);
+                synth.setTime(cpu.getCycles());
+                if (audio)
+                    emulator.getAPU().setAudioSink(&synth);
+
+                // Rewinding while recording takes back the frames rewound over
+                if (recording && emulator.getFrameCount() < movie.getStartFrame())
+                    stopRecording();
+                else if (recording)
+                    movie.truncate(emulator.getFrameCount() - movie.getStartFrame());
             }
         }
+        else
+        {
+            emulator.saveSnapshot(rewindState);
+            rewind.push(rewindState, buttons);
+
+            if (recording)
+            {
+                movie.record(buttons, 0);
+            }
+
+            if (tracing)
+            {
+                emulator.runFrame<true>();
+            }
+            else
+            {
+                emulator.runFrame();
+            }
+
+            if (audio)
+            {
+                synth.endFrame(cpu.getCycles());
+                size_t count = synth.readSamples(samples.data(), samples.size());
+
+                // Measured before the frame's samples go in, at the bottom
+                // of the level's sawtooth
+                double error = std::clamp((static_cast<double>(AudioLatency) - audio->size()) / AudioLatency, -1.0, 1.0);
+                audio->write(samples.data(), count);
+
+                rateDrift = std::clamp(rateDrift + error * maxRateChange / 64, -maxRateChange, maxRateChange);
+                double rateChange = std::clamp(rateDrift + error * maxRateChange, -maxRateChange, maxRateChange);
+                synth.setRate(AudioRate * (1 + rateChange));
+            }
+        }
+
+        // The pattern tables are drawn here, where nothing can change
+        // them halfway through
+        VideoFrame& frame = frames.back();
+        int patternTable = control.patternTable;
+        if (patternTable >= 0)
+        {
+            viewNametable(emulator.getCartridge(), static_cast<uint16_t>(patternTable * 0x1000), frame.pixels.data());
+            frame.emphasis.fill(0);
+        }
+        else
+        {
+            std::copy_n(ppu.getFrameBuffer(), frame.pixels.size(), frame.pixels.begin());
+            std::copy_n(ppu.getLineEmphasis(), frame.emphasis.size(), frame.emphasis.begin());
+        }
+        frames.publish();
+
+        // After a stall, start pacing again from now instead of rushing
+        // through the frames that were missed
+        nextFrame += framePeriod;
+        auto now = std::chrono::steady_clock::now();
+        if (nextFrame < now)
+            nextFrame = now;
+        else
+            std::this_thread::sleep_until(nextFrame);
+
+        // A queue well past its level means the sound card plays slower
+        // than the rate control can make up for, or isn't playing at
+        // all. Wait for it rather than run ahead of what is heard
+        if (audio && audio->size() > 2 * AudioLatency)
+        {
+            while (control.running && audio->size() > AudioLatency)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            nextFrame = std::chrono::steady_clock::now();
+        }
+    }
+
+    if (recording)
+        stopRecording();
+
+    emulator.getAPU().setAudioSink(nullptr);
+}
+
+// Runs a ROM for a fixed number of frames without a window and
+// reports how many CPU instructions per second the core sustains
+int runBenchmark(const char* romPath, int frames, bool trace, NEW_PPU::RenderMode renderMode)
+{
+    Emulator emulator;
+
+    if (!emulator.loadROM(romPath))
+    {
+        std::cout << "ROM not loaded.\n";
+        return -1;
+    }
+
+    emulator.getPPU().setRenderMode(renderMode);
+
+    TraceBuffer tracer(trace ? 1 << 22 : 1);
+    emulator.getCPU().setTracer(&tracer);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        if (trace)
+        {
+            emulator.runFrame<true>();
+        }
+        else
+        {
+            emulator.runFrame();
+        }
     }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    uint64_t instructions = emulator.getInstructionCount();
+
+    std::cout << "Frames:       " << frames << "\n";
+    std::cout << "Instructions: " << instructions << "\n";
+    std::cout << "Seconds:      " << elapsed.count() << "\n";
+    std::cout << "MIPS:         " << instructions / elapsed.count() / 1e6 << "\n";
+    return 0;
+}
 
-    // Render the frame buffer to screen
-    renderFrame(renderer, screenTex, frameBuffer.data());
-}
\ No newline at end of file
+// Formats a binary trace saved with F4 as nestest-style text
+int dumpTrace(const char* tracePath)
+{
+    TraceBuffer tracer(1 << 22);
+    if (!tracer.load(tracePath))
+    {
+        std::cout << "Trace not loaded.\n";
+        return -1;
+    }
+
+    tracer.dump(std::cout);
+    return 0;
+}
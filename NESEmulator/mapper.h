@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdint>
+#include "savestate.h"
 
 class Mapper
 {
@@ -7,6 +8,13 @@ protected:
 	uint8_t prgBanks;
 	uint8_t chrBanks;
 
+	// Set by a register write that changes PRG or CHR banking
+	bool prgBanksChanged = false;
+	bool chrBanksChanged = false;
+
+	// Cartridge::MirroringType picked by a register write, or -1
+	int mirroringChange = -1;
+
 public:
 	Mapper(uint8_t prgBanks, uint8_t chrBanks) 
 		: prgBanks(prgBanks), chrBanks(chrBanks) {}
@@ -20,5 +28,29 @@ public:
 	virtual bool chrMapWrite(uint16_t addr, uint32_t& mappedAddr) = 0;
 
 	virtual int mapperID() const = 0;
+
+	// Bank registers and counters for save states, none for mapper 0
+	virtual void serialize(StateStream&) {}
+
+	bool takePRGBankChange()
+	{
+		bool changed = prgBanksChanged;
+		prgBanksChanged = false;
+		return changed;
+	}
+
+	bool takeCHRBankChange()
+	{
+		bool changed = chrBanksChanged;
+		chrBanksChanged = false;
+		return changed;
+	}
+
+	int takeMirroringChange()
+	{
+		int mode = mirroringChange;
+		mirroringChange = -1;
+		return mode;
+	}
 };
 
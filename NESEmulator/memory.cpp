@@ -1,11 +1,15 @@
 #include "memory.h"
 #include <iostream>
+#include <algorithm>
+#include <iterator>
 
 Memory::Memory(Cartridge* cart, NEW_PPU* ppu, APU* apu)
 {
 	this->cartridge = cart;
 	this->ppu = ppu;
 	this->apu = apu;
+	apu->setMemory(this);
+	mapPages();
 }
 
 // For debug only!
@@ -13,26 +17,71 @@ Memory::Memory(Cartridge* cart, NEW_PPU* ppu)
 {
 	this->cartridge = cart;
 	this->ppu = ppu;
+	this->apu = nullptr;
+	mapPages();
 }
 
 // For debug only!
 Memory::Memory(Cartridge* cart)
 {
 	this->cartridge = cart;
+	this->apu = nullptr;
+	mapPages();
 }
 
-uint8_t Memory::read(uint16_t addr)
+void Memory::mapPages()
 {
-	if (addr <= 0x1FFF)
+	// Power-on RAM contents are undefined on hardware; start from zero
+	std::fill(std::begin(ram), std::end(ram), 0);
+
+	readPages.fill(nullptr);
+	writePages.fill(nullptr);
+
+	// 2KB internal RAM mirrored four times through $1FFF
+	for (int page = 0x00; page < 0x20; ++page)
 	{
-		return ram[addr % 0x0800];
+		readPages[page] = writePages[page] = &ram[(page & 0x07) << 8];
 	}
-	else if (addr >= 0x2000 && addr <= 0x3FFF)
+
+	cartridge->setBankSwitchListener([this]() { mapCartridge(); });
+	mapCartridge();
+}
+
+// ROM pages are mapped for reads only, writes still reach the mapper
+void Memory::mapCartridge()
+{
+	for (int page = 0x60; page < 0x100; ++page)
 	{
-		uint16_t reg = addr % 8;
+		readPages[page] = cartridge->getPRGPage(static_cast<uint8_t>(page));
+	}
+}
+
+void Memory::setScheduler(Scheduler* scheduler)
+{
+	this->scheduler = scheduler;
+	if (apu)
+		apu->setScheduler(scheduler);
+}
+
+void Memory::serialize(StateStream& state)
+{
+	state(ram);
+	controllers[0].serialize(state);
+	controllers[1].serialize(state);
+}
+
+uint8_t Memory::readIO(uint16_t addr)
+{
+	if (addr >= 0x2000 && addr <= 0x3FFF)
+	{
+		uint16_t reg = addr & 0x7;
 		//std::cout << "Reading from address: " << std::hex << reg << std::endl;
 		return ppu->readRegister(reg);
 	}
+	else if (addr == 0x4016 || addr == 0x4017)
+	{
+		return controllers[addr - 0x4016].read();
+	}
 	else if (addr >= 0x4000 && addr <= 0x401F)
 	{
 		return apu->readRegister(addr);
@@ -45,16 +94,26 @@ uint8_t Memory::read(uint16_t addr)
 	return 0;
 }
 
-void Memory::write(uint16_t addr, uint8_t data)
+uint8_t Memory::peek(uint16_t addr) const
 {
-	//std::cout << "Write to address: " << std::hex << addr << " with data: " << std::hex << (int)data << std::endl;
-	if (addr <= 0x1FFF)
+	if (const uint8_t* page = readPages[addr >> 8])
 	{
-		ram[addr % 0x0800] = data;
+		return page[addr & 0xFF];
 	}
-	else if (addr >= 0x2000 && addr <= 0x3FFF)
+	else if (addr >= 0x4020)
 	{
-		uint16_t reg = addr % 8;
+		return cartridge->cpuRead(addr);
+	}
+
+	return 0;
+}
+
+void Memory::writeIO(uint16_t addr, uint8_t data)
+{
+	//std::cout << "Write to address: " << std::hex << addr << " with data: " << std::hex << (int)data << std::endl;
+	if (addr >= 0x2000 && addr <= 0x3FFF)
+	{
+		uint16_t reg = addr & 0x7;
 		//std::cout << "Write to PPU register: " << reg << " with data: " << (int)data << std::endl;
 		ppu->writeRegister(reg, data);
 	}
@@ -62,6 +121,12 @@ void Memory::write(uint16_t addr, uint8_t data)
 	{
 		//std::cout << "DMA write to OAMDMA with page: " << std::hex << (int)data << std::endl;
 		ppu->setDMAPage(data);
+		scheduler->schedule(EventType::DMA, scheduler->now());
+	}
+	else if (addr == 0x4016) // Strobe for both controllers
+	{
+		controllers[0].write(data);
+		controllers[1].write(data);
 	}
 	else if (addr >= 0x4000 && addr <= 0x401F)
 	{
@@ -69,6 +134,8 @@ void Memory::write(uint16_t addr, uint8_t data)
 	}
 	else if (addr >= 0x4020 && addr <= 0xFFFF)
 	{
+		// Mapper writes can change CHR banks or mirroring mid-frame
+		ppu->catchUp();
 		cartridge->cpuWrite(addr, data);
 	}
 }
@@ -1,9 +1,13 @@
 #pragma once
 #include <cstdint>
+#include <array>
 #include "cartridge.h"
 #include "ppu.h"
 #include "new_ppu.h"
 #include "apu.h"
+#include "scheduler.h"
+#include "input.h"
+#include "savestate.h"
 
 class Memory
 {
@@ -13,6 +17,19 @@ private:
 	//PPU* ppu;
 	NEW_PPU* ppu;
 	APU* apu;
+	Scheduler* scheduler;
+	std::array<Controller, 2> controllers;
+
+	// One host pointer per 256-byte CPU page. Null pages are I/O or
+	// mapper registers and go through readIO/writeIO instead
+	std::array<uint8_t*, 256> readPages;
+	std::array<uint8_t*, 256> writePages;
+
+	void mapPages();
+	void mapCartridge();
+
+	uint8_t readIO(uint16_t addr);
+	void writeIO(uint16_t addr, uint8_t data);
 
 public:
 	Memory(Cartridge* cart, PPU* ppu, APU* apu);
@@ -21,7 +38,36 @@ public:
 	Memory(Cartridge* cart, NEW_PPU* ppu);
 	Memory(Cartridge* cart); // For debug only!
 
-	uint8_t read(uint16_t addr);
-	void write(uint16_t addr, uint8_t data);
+	uint8_t read(uint16_t addr)
+	{
+		const uint8_t* page = readPages[addr >> 8];
+		if (page)
+		{
+			return page[addr & 0xFF];
+		}
+		return readIO(addr);
+	}
+
+	void write(uint16_t addr, uint8_t data)
+	{
+		uint8_t* page = writePages[addr >> 8];
+		if (page)
+		{
+			page[addr & 0xFF] = data;
+			return;
+		}
+		writeIO(addr, data);
+	}
+
+	uint8_t* getRAM() { return ram; }
+	void setScheduler(Scheduler* scheduler);
+	Controller& getController(int port) { return controllers[port]; }
+
+	// RAM and controllers. The page tables are rebuilt by the cartridge's
+	// bank switch listener when its state is loaded
+	void serialize(StateStream& state);
+
+	// Side-effect free read for tracing; I/O registers read as 0
+	uint8_t peek(uint16_t addr) const;
 };
 
@@ -0,0 +1,101 @@
+#include "movie.h"
+#include <cstring>
+#include <fstream>
+
+static bool isPowerOn(const Emulator& emulator)
+{
+	return emulator.getFrameCount() == 0 && emulator.getInstructionCount() == 0;
+}
+
+void Movie::startRecording(Emulator& emulator)
+{
+	romHash = emulator.getCartridge().getROMHash();
+	startFrame = emulator.getFrameCount();
+	input.clear();
+
+	if (isPowerOn(emulator))
+		startState.clear();
+	else
+		emulator.saveState(startState);
+}
+
+void Movie::record(uint8_t pad1, uint8_t pad2)
+{
+	input.push_back(pad1);
+	input.push_back(pad2);
+}
+
+void Movie::truncate(size_t frames)
+{
+	if (frames < getFrameCount())
+		input.resize(frames * 2);
+}
+
+bool Movie::save(const std::string& path) const
+{
+	Header header = { { 'N', 'E', 'S', 'M' }, Version, romHash, startFrame, startState.size(), getFrameCount() };
+
+	std::ofstream file(path, std::ios::binary);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(startState.data()), startState.size());
+	file.write(reinterpret_cast<const char*>(input.data()), input.size());
+	return static_cast<bool>(file);
+}
+
+bool Movie::load(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	Header header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+	{
+		return false;
+	}
+	if (std::memcmp(header.magic, "NESM", 4) != 0 || header.version != Version)
+	{
+		return false;
+	}
+
+	// Sizes are checked against what's actually there before allocating
+	auto start = file.tellg();
+	file.seekg(0, std::ios::end);
+	uint64_t remaining = static_cast<uint64_t>(file.tellg() - start);
+	file.seekg(start);
+	if (header.stateSize > remaining || header.frameCount > (remaining - header.stateSize) / 2)
+	{
+		return false;
+	}
+
+	std::vector<uint8_t> state(header.stateSize);
+	std::vector<uint8_t> frames(header.frameCount * 2);
+	if (!file.read(reinterpret_cast<char*>(state.data()), state.size()) ||
+		!file.read(reinterpret_cast<char*>(frames.data()), frames.size()))
+	{
+		return false;
+	}
+
+	romHash = header.romHash;
+	startFrame = header.startFrame;
+	startState = std::move(state);
+	input = std::move(frames);
+	return true;
+}
+
+bool Movie::start(Emulator& emulator) const
+{
+	if (emulator.getCartridge().getROMHash() != romHash)
+	{
+		return false;
+	}
+
+	if (startsAtPowerOn())
+	{
+		return isPowerOn(emulator);
+	}
+	return emulator.loadState(startState);
+}
+
+void Movie::apply(Emulator& emulator, size_t frame) const
+{
+	emulator.getController(0).setButtons(input[frame * 2]);
+	emulator.getController(1).setButtons(input[frame * 2 + 1]);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "emulator.h"
+
+// Input movie: the ROM it was recorded on, the state it starts from and
+// both controllers for every frame after that. The core only sees input
+// between frames and is otherwise deterministic, so replaying a movie
+// reproduces the recording exactly.
+//
+// Movies recorded from power-on carry no state and replay on a freshly
+// loaded ROM, so they outlive save state version changes. Movies started
+// mid-game carry a save state and only replay on the build that wrote it
+class Movie
+{
+public:
+	static constexpr uint32_t Version = 1;
+
+	// Starts a new recording from the emulator's current state, or from
+	// power-on if it hasn't run since loading its ROM
+	void startRecording(Emulator& emulator);
+
+	// Input for the next frame, call before running it
+	void record(uint8_t pad1, uint8_t pad2);
+
+	// Drops every frame after the first frames, e.g. after rewinding
+	void truncate(size_t frames);
+
+	bool save(const std::string& path) const;
+	bool load(const std::string& path);
+
+	// Puts the emulator where the movie starts. Fails if the movie is for
+	// another ROM, or starts at power-on and the emulator has already run
+	bool start(Emulator& emulator) const;
+
+	// Sets the controllers for frame, counted from the movie's start
+	void apply(Emulator& emulator, size_t frame) const;
+
+	size_t getFrameCount() const { return input.size() / 2; }
+	uint64_t getROMHash() const { return romHash; }
+	uint64_t getStartFrame() const { return startFrame; }
+	bool startsAtPowerOn() const { return startState.empty(); }
+
+private:
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t romHash;
+		uint64_t startFrame;
+		uint64_t stateSize; // 0 when starting at power-on
+		uint64_t frameCount;
+	};
+
+	uint64_t romHash = 0;
+	uint64_t startFrame = 0; // Emulator frame count when recording started
+	std::vector<uint8_t> startState;
+	std::vector<uint8_t> input; // Pad 1 and pad 2, per frame
+};
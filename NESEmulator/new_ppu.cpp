@@ -1,6 +1,7 @@
 #include "new_ppu.h"
-#include "ppu.h"
+#include "compositor.h"
 #include <iomanip>
+#include <algorithm>
 
 NEW_PPU::NEW_PPU(Cartridge* cart)
 {
@@ -25,11 +26,24 @@ NEW_PPU::NEW_PPU(Cartridge* cart)
 	std::fill(std::begin(paletteRAM), std::end(paletteRAM), 0);
 	std::fill(std::begin(nameTables), std::end(nameTables), 0x00);
 	std::fill(std::begin(frameBuffer), std::end(frameBuffer), 0);
-
-	tileID = 0x00;
+	std::fill(std::begin(lineEmphasis), std::end(lineEmphasis), 0);
+	std::fill(std::begin(spriteLine), std::end(spriteLine), 0);
+	std::fill(std::begin(bgLine), std::end(bgLine), 0);
+
+	// Everything is zeroed, even what's overwritten before it's read, so a
+	// given ROM always powers on to the same state bytes
+	tileID = attrByte = 0x00;
+	tileLSB = tileMSB = 0x00;
 	buffer = 0x00;
+	bgPatternShiftLow = bgPatternShiftHigh = 0x0000;
+	bgAttribShiftLow = bgAttribShiftHigh = 0x0000;
+	tileAttrib = 0x00;
+	std::fill(std::begin(spriteScanline), std::end(spriteScanline), Sprite{});
+	spriteCount = 0;
+	dmaPage = 0x00;
 
-	startDMA = false;
+	mapNametables();
+	cartridge->setMirroringListener([this]() { mapNametables(); });
 }
 
 void NEW_PPU::step(uint32_t cpuCycles)
@@ -41,13 +55,49 @@ void NEW_PPU::step(uint32_t cpuCycles)
 		//printf("Frame: %d\n", frame);
 	}
 
-	if (frame == 600)
+	uint32_t dots = cpuCycles * 3;
+	if (renderMode == RenderMode::Scanline)
 	{
-		dumpNametable();
+		stepScanline(dots);
+		return;
 	}
 
-	for (int i = 0; i < cpuCycles * 3; i++)
+	if (check.enabled)
+		stepDots<true>(dots);
+	else
+		stepDots<false>(dots);
+}
+
+template<bool Check>
+void NEW_PPU::stepDots(uint32_t dots)
+{
+	for (uint32_t i = 0; i < dots; i++)
 	{ 
+		// Wrapping here, rather than after the dot, lets line 0 draw its
+		// first pixel on dot 1 like every other line
+		if (scanline == 262)
+		{
+			// Frame Complete
+			scanline = 0;
+			frame++;
+			frameComplete = true;
+		}
+
+		// Nothing is fetched or drawn for the rest of this line, so jump
+		// straight to where the remaining dots would leave us
+		if (uint32_t idle = idleDots())
+		{
+			uint32_t skip = std::min(idle, dots - i);
+			cycle += skip;
+			if (cycle > 341)
+			{
+				cycle = 1;
+				scanline++;
+			}
+			i += skip - 1;
+			continue;
+		}
+
 		// Pre-render
 		if (scanline == 261 && PPUMASK & 0x18)
 		{
@@ -56,7 +106,6 @@ void NEW_PPU::step(uint32_t cpuCycles)
 				PPUSTATUS &= ~0x80; // VBlank Clear
 				PPUSTATUS &= ~0x40; // Sprite Overflow Clear
 				PPUSTATUS &= ~0x20; // Sprite 0 Hit Clear
-				nmiOccurred = false;
 			}
 
 			if (cycle >= 1 && cycle <= 256)
@@ -86,7 +135,7 @@ void NEW_PPU::step(uint32_t cpuCycles)
 				case 3:
 				{
 					// Attribute Byte
-					attrByte = readVRAM(0x23C0 | (v & 0x0C00) | ((v >> 4) & 0x38) | ((v >> 2) & 0x07));
+					attrByte = fetchAttribute(v);
 					break;
 				}
 				case 5:
@@ -107,7 +156,12 @@ void NEW_PPU::step(uint32_t cpuCycles)
 			{
 				// Tile Data for Next Scanline
 				if (cycle == 257)
+				{
 					copyHorizontalScrollBits();
+					// No sprites on line 0
+					spriteCount = 0;
+					spriteLine.fill(0);
+				}
 
 				bgPatternShiftLow <<= 1;
 				bgPatternShiftHigh <<= 1;
@@ -177,7 +231,7 @@ void NEW_PPU::step(uint32_t cpuCycles)
 					break;
 				case 3:
 					// Attribute Byte
-					attrByte = readVRAM(0x23C0 | (v & 0x0C00) | ((v >> 4) & 0x38) | ((v >> 2) & 0x07));
+					attrByte = fetchAttribute(v);
 					break;
 				case 5:
 					// Pattern Low
@@ -210,6 +264,16 @@ void NEW_PPU::step(uint32_t cpuCycles)
 			// Visible Scanlines
 			else if (cycle >= 1 && cycle <= 256)
 			{
+				// Drawn before the shift so fine X can still select the
+				// first pixel of the leading tile
+				if (Check && cycle == 1)
+					beginCheckedLine();
+				if (Check)
+					gatherCheckedPixel();
+				renderPixel();
+				if (Check && cycle == 256)
+					checkComposedLine();
+
 				if ((PPUMASK & 0x08) || (PPUMASK & 0x10))
 				{
 					bgPatternShiftLow <<= 1;
@@ -237,7 +301,7 @@ void NEW_PPU::step(uint32_t cpuCycles)
 					case 3:
 					{
 						// Attribute Byte
-						attrByte = readVRAM(0x23C0 | (v & 0x0C00) | ((v >> 4) & 0x38) | ((v >> 2) & 0x07));
+						attrByte = fetchAttribute(v);
 						break;
 					}
 					case 5:
@@ -250,24 +314,21 @@ void NEW_PPU::step(uint32_t cpuCycles)
 						break;
 				}
 
-				if (cycle == 65)
-				{
-					//Sprite Evaluation
-					evaluateSprites();
-					fetchSpritePatterns();
-				}
-
 				if (cycle == 256)
 					incrementY();
-
-				renderPixel();
 			}
 			if (cycle >= 257 && cycle <= 320)
 			{
 				// Tile Data for Next Scanline
 				if (cycle == 257)
+				{
 					copyHorizontalScrollBits();
 
+					// Sprites found on this line are drawn on the next one
+					evaluateSprites();
+					fetchSpritePatterns();
+				}
+
 				bgPatternShiftLow <<= 1;
 				bgPatternShiftHigh <<= 1;
 				bgAttribShiftLow <<= 1;
@@ -328,7 +389,7 @@ void NEW_PPU::step(uint32_t cpuCycles)
 						break;
 					case 3:
 						// Attribute Byte
-						attrByte = readVRAM(0x23C0 | (v & 0x0C00) | ((v >> 4) & 0x38) | ((v >> 2) & 0x07));
+						attrByte = fetchAttribute(v);
 						break;
 					case 5:
 						// Pattern Low
@@ -358,13 +419,77 @@ void NEW_PPU::step(uint32_t cpuCycles)
 			{
 				//printf("VBLANK TIME\n");
 				PPUSTATUS |= 0x80;
-				if (PPUCTRL & 0x80)
+				if ((PPUCTRL & 0x80) && scheduler)
 				{
-					nmiOccurred = true;
-					nmiDelay = 2;
+					// Taken at the end of the CPU instruction this dot lands in
+					scheduler->schedule(EventType::NMI, syncedCycles + i / 3);
 				}
 			}
 		}
+		if (cycle > 340)
+		{
+			cycle = 0;
+			scanline++;
+		}
+
+		cycle++;
+	}
+}
+
+void NEW_PPU::beginCheckedLine()
+{
+	check.mask = PPUMASK;
+	check.palette = paletteRAM;
+	check.hitBefore = PPUSTATUS & 0x40;
+}
+
+// The background pixel renderPixel() is about to draw, in the form the
+// scanline renderer gathers into bgLine
+void NEW_PPU::gatherCheckedPixel()
+{
+	int shift = 15 - this->x;
+	uint8_t pixel = (((bgPatternShiftHigh >> shift) & 1) << 1) | ((bgPatternShiftLow >> shift) & 1);
+	uint8_t attrib = (((bgAttribShiftHigh >> shift) & 1) << 1) | ((bgAttribShiftLow >> shift) & 1);
+	bgLine[cycle - 1] = pixel ? (attrib << 2) | pixel : 0;
+}
+
+void NEW_PPU::checkComposedLine()
+{
+	if (PPUMASK != check.mask || paletteRAM != check.palette)
+		return;
+
+	uint8_t colorMask = (PPUMASK & 0x01) ? 0x30 : 0x3F;
+	const uint8_t* line = &frameBuffer[scanline * 256];
+
+	std::array<uint8_t, 256> composed;
+	bool hit = composePixels(bgLine.data(), spriteLine.data(), composed.data(), 0, 256, PPUMASK);
+	bool same = check.hitBefore || hit == ((PPUSTATUS & 0x40) != 0);
+	for (int i = 0; i < 256; i++)
+		same &= line[i] == (readVRAM(0x3F00 + composed[i]) & colorMask);
+
+	check.lines++;
+	if (!same)
+		check.mismatches++;
+}
+
+void NEW_PPU::clearPicture()
+{
+	// Past the visible lines the whole next picture is still to come
+	int first = 0;
+	if (scanline < 240)
+		first = scanline * 256 + std::clamp(cycle - 1, 0, 256);
+
+	std::fill(frameBuffer.begin() + first, frameBuffer.end(), readVRAM(0x3F00) & ((PPUMASK & 0x01) ? 0x30 : 0x3F));
+	std::fill(lineEmphasis.begin() + (first + 255) / 256, lineEmphasis.end(), PPUMASK >> 5);
+}
+
+// Same dot sequence as step(), but jumping between the dots that do
+// something other than fetch, and drawing pixels in runs
+void NEW_PPU::stepScanline(uint32_t dots)
+{
+	uint32_t i = 0;
+	while (i < dots)
+	{
 		if (scanline == 262)
 		{
 			// Frame Complete
@@ -373,14 +498,276 @@ void NEW_PPU::step(uint32_t cpuCycles)
 			frameComplete = true;
 		}
 
-		if (cycle > 340)
+		uint32_t skip = std::min<uint32_t>(nextDotEvent() - cycle, dots - i);
+		cycle += skip;
+		i += skip;
+		if (cycle > 341)
 		{
-			cycle = 0;
+			cycle = 1;
 			scanline++;
+			renderedX = 0;
+			continue;
+		}
+		if (i == dots)
+			break;
+
+		bool rendering = PPUMASK & 0x18;
+		bool visible = scanline <= 239;
+		if (scanline == 241 && cycle == 1)
+		{
+			PPUSTATUS |= 0x80;
+			if ((PPUCTRL & 0x80) && scheduler)
+				scheduler->schedule(EventType::NMI, syncedCycles + i / 3);
+		}
+		else if (rendering && (visible || scanline == 261))
+		{
+			if (scanline == 261 && cycle == 1)
+				PPUSTATUS &= ~0xE0; // VBlank, Sprite 0 Hit, Overflow Clear
+
+			if ((cycle <= 256 && cycle % 8 == 0) || cycle == 328 || cycle == 336)
+				incrementX();
+			if (cycle == 256)
+				incrementY();
+
+			if (cycle == 257)
+			{
+				copyHorizontalScrollBits();
+				if (visible)
+				{
+					// Finish this line before its sprites are replaced
+					renderSegment(256);
+					evaluateSprites();
+					fetchSpritePatterns();
+				}
+				else
+				{
+					spriteCount = 0;
+					spriteLine.fill(0);
+				}
+			}
+
+			if (scanline == 261 && cycle >= 280 && cycle <= 304)
+				copyVerticalScrollBits();
+
+			if (cycle == 321)
+				lineV = v;
 		}
 
 		cycle++;
+		i++;
+		if (cycle > 341)
+		{
+			cycle = 1;
+			scanline++;
+			renderedX = 0;
+		}
 	}
+
+	// Draw up to the dot we stopped on, so anything that reads or changes
+	// PPU state next sees the same frame as in dot mode
+	if (scanline <= 239)
+	{
+		int end = std::min(cycle - 1, 256);
+		if (PPUMASK & 0x18)
+			renderSegment(end);
+		else
+			renderedX = std::max(renderedX, end);
+	}
+}
+
+// Next dot on this line, from the current one, that stepScanline() has to
+// stop on, or 342 if the rest of the line only fetches
+int NEW_PPU::nextDotEvent() const
+{
+	if (scanline == 241)
+		return cycle <= 1 ? 1 : 342;
+
+	if (!(PPUMASK & 0x18) || (scanline > 239 && scanline != 261))
+		return 342;
+
+	if (scanline == 261 && cycle <= 1)
+		return 1;
+	if (cycle <= 256)
+		return (cycle + 7) & ~7;
+	if (cycle == 257)
+		return 257;
+	if (scanline == 261 && cycle <= 304)
+		return std::max(cycle, 280);
+	if (cycle <= 321)
+		return 321;
+	if (cycle <= 336)
+		return (cycle + 7) & ~7;
+	return 342;
+}
+
+// Draws pixels from renderedX up to end. Tiles are read relative to
+// lineV, the same ones the dot pipeline would have shifted in, and the
+// whole run is then composed with the sprites in one pass
+void NEW_PPU::renderSegment(int end)
+{
+	if (renderedX >= end)
+		return;
+
+	uint16_t patternBase = (PPUCTRL & 0x10) ? 0x1000 : 0x0000;
+	uint8_t fineY = (lineV >> 12) & 0x07;
+	int start = renderedX;
+
+	while (renderedX < end)
+	{
+		int fine = renderedX + x;
+		int coarseX = (lineV & 0x1F) + (fine >> 3);
+
+		uint16_t addr = lineV & ~0x001F;
+		if (coarseX >= 32)
+			addr ^= 0x0400; // Into the next nametable
+		addr |= coarseX & 0x1F;
+
+		uint8_t tile = readVRAM(0x2000 | (addr & 0x0FFF));
+		uint8_t attrib = fetchAttribute(addr);
+		const uint8_t* row = cartridge->getTileRow(patternBase + tile * 16 + fineY);
+
+		int stop = std::min(end, renderedX + 8 - (fine & 7));
+		for (; renderedX < stop; renderedX++)
+		{
+			uint8_t pixel = row[(renderedX + x) & 7];
+			bgLine[renderedX] = pixel ? (attrib << 2) | pixel : 0;
+		}
+	}
+
+	std::array<uint8_t, 256> composed;
+	if (composePixels(bgLine.data(), spriteLine.data(), composed.data(), start, end, PPUMASK))
+		PPUSTATUS |= 0x40; // Sprite 0 Hit
+
+	// Palette RAM can't change during a run, so look each entry up once
+	uint8_t colorMask = (PPUMASK & 0x01) ? 0x30 : 0x3F; // Grayscale
+	uint8_t colors[32];
+	for (int i = 0; i < 32; i++)
+		colors[i] = readVRAM(0x3F00 + i) & colorMask;
+
+	uint8_t* dest = &frameBuffer[scanline * 256];
+	for (int i = start; i < end; i++)
+		dest[i] = colors[composed[i]];
+	lineEmphasis[scanline] = PPUMASK >> 5;
+}
+
+// Dots left on the current line that do no work: vblank lines, or any
+// line while background and sprites are both disabled
+uint32_t NEW_PPU::idleDots() const
+{
+	if (scanline == 241 && cycle <= 1)
+		return 0;
+
+	bool vblank = scanline >= 241 && scanline <= 260;
+	if (vblank || !(PPUMASK & 0x18))
+		return 342 - cycle;
+	return 0;
+}
+
+// Position of a dot in step()'s frame sequence. Every line runs dots
+// 1-341, and line 262 is line 0 of the next frame
+static int frameDot(int scanline, int cycle)
+{
+	return (scanline % 262) * 341 + (cycle - 1);
+}
+
+void NEW_PPU::serialize(StateStream& state)
+{
+	state(PPUCTRL);
+	state(PPUMASK);
+	state(PPUSTATUS);
+	state(OAMADDR);
+	state(PPUSCROLL);
+	state(PPUADDR);
+	state(PPUDATA);
+	state(v);
+	state(t);
+	state(x);
+	state(w);
+	state(scanline);
+	state(cycle);
+	state(frame);
+	state(frameComplete);
+
+	state(oamData);
+	state(paletteRAM);
+	state(nameTables);
+	if (state.hasPicture())
+	{
+		state(frameBuffer);
+		state(lineEmphasis);
+	}
+
+	state(tileID);
+	state(attrByte);
+	state(tileLSB);
+	state(tileMSB);
+	state(buffer);
+	state(bgPatternShiftLow);
+	state(bgPatternShiftHigh);
+	state(bgAttribShiftLow);
+	state(bgAttribShiftHigh);
+	state(tileAttrib);
+
+	state(spriteScanline);
+	state(spriteCount);
+	state(spriteLine);
+	state(spriteZeroHit);
+	state(dmaPage);
+	state(syncedCycles);
+
+	state(lineV);
+	state(renderedX);
+	state(bgLine);
+
+	if (state.isLoading())
+		mapNametables();
+}
+
+void NEW_PPU::setScheduler(Scheduler* scheduler)
+{
+	this->scheduler = scheduler;
+	scheduler->setHandler(EventType::PPUSync, [this]() { catchUp(); });
+}
+
+void NEW_PPU::catchUp()
+{
+	if (!cpuClock)
+		return;
+
+	uint64_t target = *cpuClock;
+	if (target > syncedCycles)
+		step(static_cast<uint32_t>(target - syncedCycles));
+	syncedCycles = target;
+	if (scheduler)
+		scheduler->schedule(EventType::PPUSync, syncedCycles + cyclesUntilEvent());
+}
+
+uint32_t NEW_PPU::cyclesUntilEvent() const
+{
+	const int frameDots = 262 * 341;
+	const int events[] = { frameDot(241, 1), frameDot(0, 1) }; // VBlank, frame end
+
+	int now = frameDot(scanline, cycle);
+	int dots = frameDots;
+	for (int event : events)
+	{
+		int until = event - now + 1;
+		if (until <= 0)
+			until += frameDots;
+		if (until < dots)
+			dots = until;
+	}
+
+	// First CPU cycle whose PPU step covers the event dot
+	return (dots + 2) / 3;
+}
+
+// Attribute bits for the tile at addr. Each byte covers 4x4 tiles and
+// bit 1 of coarse X/Y picks the 2x2 quadrant
+uint8_t NEW_PPU::fetchAttribute(uint16_t addr)
+{
+	uint8_t attr = readVRAM(0x23C0 | (addr & 0x0C00) | ((addr >> 4) & 0x38) | ((addr >> 2) & 0x07));
+	return (attr >> (((addr >> 4) & 0x04) | (addr & 0x02))) & 0x03;
 }
 
 void NEW_PPU::copyVerticalScrollBits()
@@ -431,6 +818,8 @@ void NEW_PPU::incrementY()
 
 uint8_t NEW_PPU::readRegister(uint16_t addr)
 {
+	catchUp();
+
 	uint8_t result = 0;
 	addr += 0x2000;
 
@@ -462,6 +851,8 @@ uint8_t NEW_PPU::readRegister(uint16_t addr)
 
 void NEW_PPU::writeRegister(uint16_t addr, uint8_t value)
 {
+	catchUp();
+
 	addr = addr + 0x2000;
 
 	switch (addr)
@@ -469,6 +860,8 @@ void NEW_PPU::writeRegister(uint16_t addr, uint8_t value)
 		case 0x2000:
 			PPUCTRL = value;
 			//PPUCTRL |= 0x80;
+			if (!(value & 0x80) && scheduler)
+				scheduler->cancel(EventType::NMI);
 			t = (t & 0xF3FF) | ((value & 0x03) << 10);
 			break;
 		case 0x2001:
@@ -524,9 +917,9 @@ uint8_t NEW_PPU::readVRAM(uint16_t addr)
 	{
 		return cartridge->chrRead(addr);
 	}
-	else if (addr < 0x3000)
+	else if (addr < 0x3F00)
 	{
-		return nameTables[mirrorNametableAddress(addr)];
+		return nametablePages[(addr >> 10) & 0x03][addr & 0x03FF];
 	}
 	else if (addr < 0x4000)
 	{
@@ -542,10 +935,9 @@ void NEW_PPU::writeVRAM(uint16_t addr, uint8_t value)
 	{
 		cartridge->chrWrite(addr, value);
 	}
-	if (addr < 0x3000)
+	else if (addr < 0x3F00)
 	{
-		//printf("Attempting to write to NameTable at address %04X with value %02X\n", mirrorNametableAddress(addr), value);
-		nameTables[mirrorNametableAddress(addr)] = value;
+		nametablePages[(addr >> 10) & 0x03][addr & 0x03FF] = value;
 	}
 	else if (addr < 0x4000)
 	{
@@ -553,39 +945,20 @@ void NEW_PPU::writeVRAM(uint16_t addr, uint8_t value)
 	}
 }
 
-uint16_t NEW_PPU::mirrorNametableAddress(uint16_t addr)
+// Points the four nametable slots at VRAM for the cartridge's mirroring
+void NEW_PPU::mapNametables()
 {
-	// Grab last 3 digits
-	addr &= 0x0FFF;
-
-	// Determine which table it is trying to access
-	// Table 0 - 0x000 Table 1 - 0x400
-	// Table 2 - 0x800 Table 3 - 0xC00
-	uint16_t table = addr / 0x400;
-	uint16_t offset = addr % 0x400;
-
-	switch (cartridge->getMode())
-	{
-		case Cartridge::Vertical:
-			//printf("Vertical Mirroring\n");
-			if (table == 2) table = 0;
-			if (table == 3) table = 1;
-			break;
-		case Cartridge::Horizontal:
-			if (table == 1) table = 0;
-			if (table == 3 || table == 2) table = 1;
-			break;
-		case Cartridge::SingleScreenLower:
-			table = 0;
-			break;
-		case Cartridge::SingleScreenUpper:
-			table = 1;
-			break;
-		case Cartridge::FourScreen:
-			break;
-	}
-
-	return table * 0x400 + offset;
+	static const uint8_t layouts[][4] = {
+		{ 0, 0, 1, 1 }, // Horizontal
+		{ 0, 1, 0, 1 }, // Vertical
+		{ 0, 0, 0, 0 }, // SingleScreenLower
+		{ 1, 1, 1, 1 }, // SingleScreenUpper
+		{ 0, 1, 2, 3 }  // FourScreen
+	};
+
+	const uint8_t* layout = layouts[cartridge->getMode()];
+	for (int i = 0; i < 4; i++)
+		nametablePages[i] = &nameTables[layout[i] * 0x400];
 }
 
 uint8_t NEW_PPU::mirrorPaletteAddress(uint16_t addr)
@@ -598,20 +971,6 @@ uint8_t NEW_PPU::mirrorPaletteAddress(uint16_t addr)
 	return addr;
 }
 
-bool NEW_PPU::getNMI()
-{
-	if (nmiDelay > 0)
-	{
-		nmiDelay--;
-		if (nmiDelay == 0 && nmiOccurred && (PPUCTRL & 0x80))
-		{
-			//printf("PPU triggered NMI at scanline %d, cycle %d\n", scanline, cycle);
-			return true; // NMI triggered
-		}
-	}
-	return false; // No NMI triggered
-}
-
 void NEW_PPU::evaluateSprites()
 {
 	spriteCount = 0;
@@ -643,9 +1002,12 @@ void NEW_PPU::evaluateSprites()
 	}
 }
 
+// Fetches the pattern rows of the sprites found by evaluateSprites() and
+// rasterizes them into spriteLine for the next line
 void NEW_PPU::fetchSpritePatterns()
 {
 	uint8_t spriteHeight = (PPUCTRL & 0x20) ? 16 : 8;
+	spriteLine.fill(0);
 
 	for (int i = 0; i < spriteCount; ++i)
 	{
@@ -682,25 +1044,47 @@ void NEW_PPU::fetchSpritePatterns()
 			addr = patternBase + tileIndex * 16 + yOffset;
 		}
 
-		sprite.patternLow = readVRAM(addr);
-		sprite.patternHigh = readVRAM(addr + 8);
+		uint8_t flags = 0x10 | ((attributes & 0x03) << 2);
+		if (attributes & 0x20)
+			flags |= SpriteBehind;
+		if (i == 0 && spriteZeroHit)
+			flags |= SpriteZero;
+
+		// Earlier slots have priority, so only fill pixels still empty
+		const uint8_t* pixels = cartridge->getTileRow(addr, attributes & 0x40);
+		int width = std::min(8, 256 - sprite.x);
+		for (int col = 0; col < width; col++)
+		{
+			uint8_t& out = spriteLine[sprite.x + col];
+			if (pixels[col] && !out)
+				out = flags | pixels[col];
+		}
 	}
 }
 
 void NEW_PPU::renderPixel()
 {
-	int x = cycle - 1;
-	int y = scanline;
+	// Fine X selects how far into the shifters the pixel is taken from
+	int shift = 15 - this->x;
 
 	// Background Rendering
-	uint8_t bit0 = (bgPatternShiftLow >> 15) & 1;
-	uint8_t bit1 = (bgPatternShiftHigh >> 15) & 1;
+	uint8_t bit0 = (bgPatternShiftLow >> shift) & 1;
+	uint8_t bit1 = (bgPatternShiftHigh >> shift) & 1;
 	uint8_t paletteIndex = (bit1 << 1) | bit0;
 
-	uint8_t atrr0 = (bgAttribShiftLow >> 15) & 1;
-	uint8_t atrr1 = (bgAttribShiftHigh >> 15) & 1;
+	uint8_t atrr0 = (bgAttribShiftLow >> shift) & 1;
+	uint8_t atrr1 = (bgAttribShiftHigh >> shift) & 1;
 	uint8_t paletteHighBits = (atrr1 << 1) | atrr0;
 
+	drawPixel(cycle - 1, paletteIndex, paletteHighBits);
+}
+
+// Combines a background pixel with the sprites on this line and writes
+// the result to the frame buffer. Shared by both render modes
+void NEW_PPU::drawPixel(int x, uint8_t paletteIndex, uint8_t paletteHighBits)
+{
+	int y = scanline;
+
 	uint8_t paletteAddr = (paletteHighBits << 2) | paletteIndex;
 
 	if (paletteIndex == 0)
@@ -715,36 +1099,18 @@ void NEW_PPU::renderPixel()
 	uint8_t spriteColor = 0x00;
 	bool spritePriority = false;
 
-	if (PPUMASK & 0x10)  // Check if sprites are enabled
+	uint8_t spritePixel = spriteLine[x];
+	if ((PPUMASK & 0x10) && spritePixel)  // Check if sprites are enabled
 	{
-		for (int i = 0; i < spriteCount; ++i)
-		{
-			int spriteX = spriteScanline[i].x;
-			int offset = x - spriteX;
-			if (offset < 0 || offset >= 8) continue;
-
-			bool flipH = spriteScanline[i].attributes & 0x40;
-			int bitIndex = flipH ? offset : (7 - offset);
-
-			uint8_t spriteBit0 = (spriteScanline[i].patternLow >> bitIndex) & 1;
-			uint8_t spriteBit1 = (spriteScanline[i].patternHigh >> bitIndex) & 1;
-			uint8_t spritePixel = (spriteBit1 << 1) | spriteBit0;
-
-			if (spritePixel == 0) continue;
+		spriteColor = readVRAM(0x3F00 + (spritePixel & 0x1F));
+		spritePriority = !(spritePixel & SpriteBehind);
+		spriteVisible = true;
 
-			uint8_t spritePalette = spriteScanline[i].attributes & 0x03;
-			spriteColor = readVRAM(0x3F10 + (spritePalette << 2) + spritePixel);
-			spritePriority = !(spriteScanline[i].attributes & 0x20);
-			spriteVisible = true;
-
-			// Sprite 0 hit detection
-			if (i == 0 && bgOpaque && x < 255 && (PPUMASK & 0x18))
-			{
-				//std::cout << "[PPU] Sprite 0 hit at scanline " << scanline << ", cycle " << cycle << std::endl;
-				PPUSTATUS |= 0x40;
-			}
-
-			break;  // Use first non-transparent sprite pixel
+		// Sprite 0 hit detection
+		if ((spritePixel & SpriteZero) && bgOpaque && x < 255)
+		{
+			//std::cout << "[PPU] Sprite 0 hit at scanline " << scanline << ", cycle " << cycle << std::endl;
+			PPUSTATUS |= 0x40;
 		}
 	}
 
@@ -787,7 +1153,8 @@ void NEW_PPU::renderPixel()
 		}
 	}
 
-	frameBuffer[y * 256 + x] = NESPalette[finalColor];
+	frameBuffer[y * 256 + x] = finalColor & ((PPUMASK & 0x01) ? 0x30 : 0x3F); // Grayscale keeps the brightness bits
+	lineEmphasis[y] = PPUMASK >> 5;
 }
 
 void NEW_PPU::dumpNametable()
@@ -5,6 +5,8 @@
 #include <iostream>
 #include <ctime>
 #include "cartridge.h"
+#include "scheduler.h"
+#include "savestate.h"
 
 class NEW_PPU
 {
@@ -31,8 +33,10 @@ class NEW_PPU
 		// Arrays
 		std::array<uint8_t, 256> oamData;
 		std::array<uint8_t, 32> paletteRAM;
-		std::array<uint8_t, 2048> nameTables;
-		std::array<uint32_t, 256 * 240> frameBuffer;
+		std::array<uint8_t, 4096> nameTables; // 2 KB internal, 4 KB with FourScreen
+		std::array<uint8_t*, 4> nametablePages; // 1 KB page behind $2000, $2400, $2800, $2C00
+		std::array<uint8_t, 256 * 240> frameBuffer; // 6-bit palette indices
+		std::array<uint8_t, 240> lineEmphasis;      // PPUMASK bits 5-7 per line
 
 		// Tile Info
 		uint8_t tileID, attrByte;
@@ -53,26 +57,93 @@ class NEW_PPU
 			uint8_t x;           // X position
 			uint8_t tileID;      // Tile ID
 			uint8_t attributes;  // Attributes (palette, flip, etc.)
-			uint8_t patternLow;  // Low byte of the sprite pattern
-			uint8_t patternHigh; // High byte of the sprite pattern
 		};
 
 		Sprite spriteScanline[8];
 		uint8_t spriteCount;
+
+		// Sprites of the line being drawn, rasterized when they are fetched:
+		// palette address, priority and sprite 0 flags as composePixels() takes
+		std::array<uint8_t, 256> spriteLine;
 		bool spriteZeroHit = false;
 
 		uint8_t dmaPage;
-		int nmiDelay;
-		bool nmiOccurred;
 
-		bool startDMA;
+		// Catch-up timing: the PPU only runs when something needs to see
+		// it, up to the CPU cycle count it reads through cpuClock
+		const uint64_t* cpuClock = nullptr;
+		uint64_t syncedCycles = 0;
+		Scheduler* scheduler = nullptr;
+
+		uint32_t cyclesUntilEvent() const;
+		uint32_t idleDots() const;
+
+	public:
+		// Dot runs the fetch pipeline on every dot. Scanline only stops on
+		// dots that change v or the sprite buffer and draws whole runs of
+		// pixels from the line's starting v, so mid-line changes to v,
+		// pattern tables or VRAM show up later than on hardware
+		enum class RenderMode { Dot, Scanline };
 
+	private:
+		RenderMode renderMode = RenderMode::Dot;
+		uint16_t lineV = 0; // v at the first tile of the next visible line
+		int renderedX = 0;  // Pixels of the current line already drawn
+
+		// Current line's background pixels, gathered before they are composed
+		std::array<uint8_t, 256> bgLine;
+
+		// Self test: with Check set, stepDots() composes every line that
+		// drawPixel() drew again with composePixels() and compares them.
+		// Lines where PPUMASK or the palette changed are skipped, and the
+		// sprite 0 hit only counts on lines that start without one
+		struct CompositorCheck
+		{
+			bool enabled = false;
+			uint8_t mask = 0;
+			std::array<uint8_t, 32> palette{};
+			bool hitBefore = false;
+			uint32_t lines = 0;
+			uint32_t mismatches = 0;
+		} check;
+
+		template<bool Check>
+		void stepDots(uint32_t dots);
+		void beginCheckedLine();
+		void gatherCheckedPixel();
+		void checkComposedLine();
+
+		void stepScanline(uint32_t dots);
+		int nextDotEvent() const;
+		void renderSegment(int end);
 
 	public:
 		NEW_PPU(Cartridge* cart);
 
+		void setRenderMode(RenderMode mode) { renderMode = mode; }
+		RenderMode getRenderMode() const { return renderMode; }
+
+		void setCompositorCheck(bool enabled) { check.enabled = enabled; }
+		uint32_t getCheckedLines() const { return check.lines; }
+		uint32_t getMismatchedLines() const { return check.mismatches; }
+
 		void step(uint32_t cpuCycles);
 
+		void setClock(const uint64_t* clock) { cpuClock = clock; }
+		void setScheduler(Scheduler* scheduler);
+		void catchUp();
+
+		// Everything but the render mode, which is a frontend setting.
+		// Full save states include the frame buffer, so one loaded
+		// mid-frame keeps the lines already drawn. Rewind snapshots leave
+		// the picture out (see StateStream::setPicture) and keep whatever
+		// is in the frame buffer when loaded
+		void serialize(StateStream& state);
+
+		// Fills the pixels not yet drawn this frame with the backdrop
+		// color, as the screen shows it on lines drawn with rendering off
+		void clearPicture();
+
 		void copyVerticalScrollBits();
 		void copyHorizontalScrollBits();
 
@@ -87,16 +158,11 @@ class NEW_PPU
 		uint8_t readVRAM(uint16_t addr);
 		void writeVRAM(uint16_t addr, uint8_t value);
 
-		uint16_t mirrorNametableAddress(uint16_t addr);
+		void mapNametables();
 		uint8_t mirrorPaletteAddress(uint16_t addr);
 
 		uint8_t getDMAPage() const { return dmaPage; }
-		void setDMAPage(uint8_t page) { dmaPage = page; startDMA = true; }
-		bool isDMATriggered() { return startDMA; }
-		void clearDMA() { startDMA = false; }
-
-		void clearNMI() { nmiDelay = 0; }
-		bool getNMI();
+		void setDMAPage(uint8_t page) { dmaPage = page; }
 
 		bool isFrameComplete() const { return frameComplete; }
 		void resetFrameComplete() { frameComplete = false; }
@@ -104,32 +170,16 @@ class NEW_PPU
 		void evaluateSprites();
 		void fetchSpritePatterns();
 
+		uint8_t fetchAttribute(uint16_t addr);
 		void renderPixel();
+		void drawPixel(int x, uint8_t paletteIndex, uint8_t paletteHighBits);
 
-		uint32_t* getFrameBuffer() const { return const_cast<uint32_t*>(frameBuffer.data()); }
+		// Indexed frame and per-line emphasis, see convertFrame() in palette.h
+		const uint8_t* getFrameBuffer() const { return frameBuffer.data(); }
+		const uint8_t* getLineEmphasis() const { return lineEmphasis.data(); }
 
 		// DEBUG
 		void dumpNametable();
 		int getScanline() const { return scanline; }
 		int getCycle() const { return cycle; }
 };
-
-static const uint32_t Palette[64] = {
-	0x545454FF, 0x001E74FF, 0x081090FF, 0x300088FF,
-	0x440064FF, 0x5C0030FF, 0x540400FF, 0x3C1800FF,
-	0x202A00FF, 0x083A00FF, 0x003C00FF, 0x003A10FF,
-	0x002840FF, 0x000000FF, 0x000000FF, 0x000000FF,
-	0x989898FF, 0x084CC4FF, 0x3032ECFF, 0x5C1EE4FF,
-	0x8814B0FF, 0xA01464FF, 0x982220FF, 0x783C00FF,
-	0x545A00FF, 0x287200FF, 0x087C00FF, 0x007628FF,
-	0x006678FF, 0x000000FF, 0x000000FF, 0x000000FF,
-	0xECECECFF, 0x4C9AEFFF, 0x787CFFFF, 0xB062FFFF,
-	0xE454E4FF, 0xFC58B8FF, 0xF87858FF, 0xFCA044FF,
-	0xF0C000FF, 0xA0D800FF, 0x48E400FF, 0x00CC44FF,
-	0x00B4CCFF, 0x3C3C3CFF, 0x000000FF, 0x000000FF,
-	0xECECECFF, 0xA8D8F8FF, 0xB8B8FFFF, 0xD8B8F8FF,
-	0xF8B8F8FF, 0xF8B8D8FF, 0xF8C8B8FF, 0xF0D8A8FF,
-	0xF0E4A0FF, 0xC8F0A0FF, 0xA8F0B8FF, 0xB8F8B8FF,
-	0xB8F8D8FF, 0x787878FF, 0x000000FF, 0x000000FF
-};
-
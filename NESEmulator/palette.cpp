@@ -0,0 +1,64 @@
+#include "palette.h"
+#include <array>
+
+const uint32_t NESPalette[64] = {
+	0x545454FF, 0x001E74FF, 0x081090FF, 0x300088FF,
+	0x440064FF, 0x5C0030FF, 0x540400FF, 0x3C1800FF,
+	0x202A00FF, 0x083A00FF, 0x003C00FF, 0x003A10FF,
+	0x002840FF, 0x000000FF, 0x000000FF, 0x000000FF,
+	0x989898FF, 0x084CC4FF, 0x3032ECFF, 0x5C1EE4FF,
+	0x8814B0FF, 0xA01464FF, 0x982220FF, 0x783C00FF,
+	0x545A00FF, 0x287200FF, 0x087C00FF, 0x007628FF,
+	0x006678FF, 0x000000FF, 0x000000FF, 0x000000FF,
+	0xECECECFF, 0x4C9AEFFF, 0x787CFFFF, 0xB062FFFF,
+	0xE454E4FF, 0xFC58B8FF, 0xF87858FF, 0xFCA044FF,
+	0xF0C000FF, 0xA0D800FF, 0x48E400FF, 0x00CC44FF,
+	0x00B4CCFF, 0x3C3C3CFF, 0x000000FF, 0x000000FF,
+	0xECECECFF, 0xA8D8F8FF, 0xB8B8FFFF, 0xD8B8F8FF,
+	0xF8B8F8FF, 0xF8B8D8FF, 0xF8C8B8FF, 0xF0D8A8FF,
+	0xF0E4A0FF, 0xC8F0A0FF, 0xA8F0B8FF, 0xB8F8B8FF,
+	0xB8F8D8FF, 0x787878FF, 0x000000FF, 0x000000FF
+};
+
+// One palette per combination of emphasis bits (red, green, blue). Any
+// emphasis darkens the channels that aren't emphasized to about 82%
+static const std::array<std::array<uint32_t, 64>, 8> emphasisPalettes = []()
+{
+	std::array<std::array<uint32_t, 64>, 8> palettes;
+
+	for (int emphasis = 0; emphasis < 8; emphasis++)
+	{
+		for (int i = 0; i < 64; i++)
+		{
+			uint32_t color = NESPalette[i];
+			if (emphasis)
+			{
+				for (int channel = 0; channel < 3; channel++)
+				{
+					if (emphasis & (1 << channel))
+						continue;
+
+					int shift = 24 - channel * 8; // Red is the top byte
+					uint32_t value = (color >> shift) & 0xFF;
+					color = (color & ~(0xFFu << shift)) | ((value * 209 / 256) << shift);
+				}
+			}
+			palettes[emphasis][i] = color;
+		}
+	}
+
+	return palettes;
+}();
+
+void convertFrame(const uint8_t* indices, const uint8_t* emphasis, uint32_t* out)
+{
+	for (int y = 0; y < 240; y++)
+	{
+		const uint32_t* palette = emphasisPalettes[emphasis[y] & 0x07].data();
+		const uint8_t* line = indices + y * 256;
+		uint32_t* dest = out + y * 256;
+
+		for (int x = 0; x < 256; x++)
+			dest[x] = palette[line[x] & 0x3F];
+	}
+}
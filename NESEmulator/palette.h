@@ -0,0 +1,10 @@
+#pragma once
+#include <cstdint>
+
+// The 64 NES colors as RGBA8888 (0xRRGGBBAA)
+extern const uint32_t NESPalette[64];
+
+// Converts an indexed frame from NEW_PPU to RGBA8888. indices holds one
+// 6-bit palette index per pixel and emphasis holds PPUMASK bits 5-7,
+// shifted down, for each of the 240 lines
+void convertFrame(const uint8_t* indices, const uint8_t* emphasis, uint32_t* out);
@@ -0,0 +1,214 @@
+#include "rewind.h"
+#include <algorithm>
+#include <cstring>
+
+// Encoded deltas are a list of tokens: a count of bytes equal to the
+// base, a count of literal bytes, then the literals XORed with the base.
+// Counts take 7 bits per byte, so the short runs between a frame's
+// scattered changes cost a byte each. A literal run only ends where at
+// least MinRun equal bytes follow, enough to pay for the next header
+static const size_t MinRun = 3;
+
+static size_t worstCaseSize(size_t stateSize)
+{
+	// Every token covers at least MinRun bytes, and a count is at most
+	// 10 bytes long
+	return stateSize + 20 * (stateSize / MinRun + 2);
+}
+
+static size_t putCount(uint8_t* out, size_t count)
+{
+	size_t o = 0;
+	while (count >= 0x80)
+	{
+		out[o++] = static_cast<uint8_t>(count | 0x80);
+		count >>= 7;
+	}
+	out[o++] = static_cast<uint8_t>(count);
+	return o;
+}
+
+static size_t getCount(const uint8_t* in, size_t inSize, size_t& p)
+{
+	size_t count = 0;
+	for (int shift = 0; p < inSize; shift += 7)
+	{
+		uint8_t byte = in[p++];
+		count |= static_cast<size_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			break;
+	}
+	return count;
+}
+
+RewindBuffer::RewindBuffer(size_t stateSize, size_t arenaBytes, size_t maxSnapshots)
+	: stateSize(stateSize), arena(arenaBytes), deltas(maxSnapshots > 1 ? maxSnapshots - 1 : 1),
+	newest(stateSize), previous(stateSize), scratch(worstCaseSize(stateSize))
+{
+}
+
+void RewindBuffer::clear()
+{
+	head = 0;
+	used = 0;
+	first = 0;
+	count = 0;
+}
+
+void RewindBuffer::push(const std::vector<uint8_t>& state, uint8_t input)
+{
+	if (count > 0)
+	{
+		// What turns the new state back into the one before it
+		size_t size = encode(newest.data(), state.data(), stateSize, scratch.data());
+
+		size_t offset;
+		while (deltaCount() == deltas.size() || !place(size, offset))
+		{
+			if (deltaCount() == 0)
+			{
+				clear(); // A delta bigger than the whole arena
+				break;
+			}
+			dropOldest();
+		}
+
+		if (count > 0)
+		{
+			std::memcpy(&arena[offset], scratch.data(), size);
+			at(count - 1) = { offset, size, newestInput };
+			head = offset + size;
+			used += size;
+		}
+	}
+
+	std::memcpy(newest.data(), state.data(), stateSize);
+	newestInput = input;
+	count++;
+}
+
+bool RewindBuffer::pop(std::vector<uint8_t>& state, uint8_t& input)
+{
+	if (count == 0)
+	{
+		return false;
+	}
+
+	state.resize(stateSize);
+	std::memcpy(state.data(), newest.data(), stateSize);
+	input = newestInput;
+	count--;
+
+	if (count > 0)
+	{
+		Delta delta = at(count - 1);
+		decode(&arena[delta.offset], delta.size, newest.data(), previous.data(), stateSize);
+		newest.swap(previous);
+		newestInput = delta.input;
+
+		used -= delta.size;
+		head = count > 1 ? at(count - 2).offset + at(count - 2).size : 0;
+	}
+	return true;
+}
+
+// Deltas are laid out in push order around the arena; one that doesn't
+// fit before the end starts over at the beginning
+bool RewindBuffer::place(size_t size, size_t& offset)
+{
+	if (deltaCount() == 0)
+	{
+		offset = 0;
+		return size <= arena.size();
+	}
+
+	size_t oldest = at(0).offset;
+	if (head > oldest)
+	{
+		if (size <= arena.size() - head)
+		{
+			offset = head;
+			return true;
+		}
+		offset = 0;
+		return size <= oldest;
+	}
+
+	offset = head;
+	return size <= oldest - head;
+}
+
+void RewindBuffer::dropOldest()
+{
+	used -= at(0).size;
+	first = (first + 1) % deltas.size();
+	count--;
+	if (deltaCount() == 0)
+	{
+		head = 0;
+	}
+}
+
+size_t RewindBuffer::encode(const uint8_t* state, const uint8_t* base, size_t size, uint8_t* out)
+{
+	auto same = [&](size_t i) { return state[i] == base[i]; };
+
+	// Equal bytes starting at i, up to MinRun, or the rest of the state
+	auto endsLiteral = [&](size_t i)
+	{
+		for (size_t j = i; j < i + MinRun; j++)
+		{
+			if (j == size)
+				return true;
+			if (!same(j))
+				return false;
+		}
+		return true;
+	};
+
+	size_t i = 0;
+	size_t o = 0;
+	while (i < size)
+	{
+		// Unchanged bytes, 8 at a time while they last
+		size_t runStart = i;
+		while (i + 8 <= size)
+		{
+			uint64_t a, b;
+			std::memcpy(&a, state + i, 8);
+			std::memcpy(&b, base + i, 8);
+			if (a != b)
+				break;
+			i += 8;
+		}
+		while (i < size && same(i))
+			i++;
+
+		size_t literalStart = i;
+		while (i < size && !(same(i) && endsLiteral(i)))
+			i++;
+
+		o += putCount(out + o, literalStart - runStart);
+		o += putCount(out + o, i - literalStart);
+		for (size_t j = literalStart; j < i; j++)
+			out[o++] = state[j] ^ base[j];
+	}
+	return o;
+}
+
+void RewindBuffer::decode(const uint8_t* in, size_t inSize, const uint8_t* base, uint8_t* out, size_t size)
+{
+	size_t i = 0;
+	size_t p = 0;
+	while (p < inSize && i < size)
+	{
+		size_t run = std::min(getCount(in, inSize, p), size - i);
+		std::memcpy(out + i, base + i, run);
+		i += run;
+
+		size_t literals = std::min(getCount(in, inSize, p), std::min(size - i, inSize - p));
+		for (size_t j = 0; j < literals; j++, i++)
+			out[i] = in[p + j] ^ base[i];
+		p += literals;
+	}
+}
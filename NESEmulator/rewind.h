@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Fixed-size history of save states for rewinding. Only the newest
+// state is kept whole; every older one is stored as its XOR against the
+// one after it, run-length coded so the bytes that didn't change between
+// two frames cost next to nothing. Popping undoes one delta at a time,
+// and the oldest delta can always be dropped to make room since nothing
+// depends on it. Deltas live in one preallocated arena, so push() and
+// pop() never allocate. Each snapshot also keeps the controller input
+// of the frame that was run from it
+class RewindBuffer
+{
+public:
+	RewindBuffer(size_t stateSize, size_t arenaBytes, size_t maxSnapshots);
+
+	// state must be stateSize bytes
+	void push(const std::vector<uint8_t>& state, uint8_t input);
+
+	// Removes the newest snapshot and writes it to state and input.
+	// Returns false once the history is empty
+	bool pop(std::vector<uint8_t>& state, uint8_t& input);
+
+	void clear();
+
+	size_t size() const { return count; }
+	size_t bytesUsed() const { return used; }
+
+private:
+	struct Delta
+	{
+		size_t offset; // In the arena
+		size_t size;   // Encoded bytes
+		uint8_t input; // Of the snapshot the delta leads back to
+	};
+
+	size_t stateSize;
+
+	std::vector<uint8_t> arena;
+	size_t head = 0; // Where the next delta goes
+	size_t used = 0; // Encoded bytes held, for reporting
+
+	std::vector<Delta> deltas; // Ring, oldest at first
+	size_t first = 0;
+	size_t count = 0;          // Snapshots, one more than the deltas held
+
+	std::vector<uint8_t> newest;   // The newest snapshot, decoded
+	uint8_t newestInput = 0;
+	std::vector<uint8_t> previous; // Decoder output while popping
+	std::vector<uint8_t> scratch;  // Encoder output, sized for the worst case
+
+	size_t deltaCount() const { return count > 0 ? count - 1 : 0; }
+	Delta& at(size_t i) { return deltas[(first + i) % deltas.size()]; }
+	bool place(size_t size, size_t& offset);
+	void dropOldest();
+
+	static size_t encode(const uint8_t* state, const uint8_t* base, size_t size, uint8_t* out);
+	static void decode(const uint8_t* in, size_t inSize, const uint8_t* base, uint8_t* out, size_t size);
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Lock-free FIFO for one producer and one consumer thread. Each side
+// only writes its own index and reads the other's, so neither ever waits:
+// writes that don't fit and reads past the end are cut short instead.
+// Capacity is rounded up to a power of two
+template<typename T>
+class RingBuffer
+{
+public:
+	explicit RingBuffer(size_t capacity)
+	{
+		size_t size = 1;
+		while (size < capacity)
+			size <<= 1;
+		items.resize(size);
+		mask = size - 1;
+	}
+
+	// Producer only. Returns how many items fit
+	size_t write(const T* data, size_t count)
+	{
+		size_t writeIndex = head.load(std::memory_order_relaxed);
+		size_t readIndex = tail.load(std::memory_order_acquire);
+		count = std::min(count, items.size() - (writeIndex - readIndex));
+
+		for (size_t i = 0; i < count; i++)
+			items[(writeIndex + i) & mask] = data[i];
+
+		head.store(writeIndex + count, std::memory_order_release);
+		return count;
+	}
+
+	// Consumer only. Returns how many items were read
+	size_t read(T* data, size_t count)
+	{
+		size_t readIndex = tail.load(std::memory_order_relaxed);
+		size_t writeIndex = head.load(std::memory_order_acquire);
+		count = std::min(count, writeIndex - readIndex);
+
+		for (size_t i = 0; i < count; i++)
+			data[i] = items[(readIndex + i) & mask];
+
+		tail.store(readIndex + count, std::memory_order_release);
+		return count;
+	}
+
+	// Items queued. Either side may call it, the other can change it
+	// right after
+	size_t size() const
+	{
+		size_t readIndex = tail.load(std::memory_order_acquire);
+		return head.load(std::memory_order_acquire) - readIndex;
+	}
+
+	size_t capacity() const { return items.size(); }
+
+private:
+	std::vector<T> items;
+	size_t mask;
+
+	// On separate cache lines so the two threads don't share one
+	alignas(64) std::atomic<size_t> head{ 0 }; // Next write, producer's
+	alignas(64) std::atomic<size_t> tail{ 0 }; // Next read, consumer's
+};
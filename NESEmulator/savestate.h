@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <type_traits>
+
+// Visitor passed to each component's serialize(). The component lists
+// its fields in a fixed order and the same code either appends them to
+// a buffer or reads them back, so saving and loading can't drift apart.
+// Fields are raw host-endian bytes; a state is only meant to be loaded
+// by the build that wrote it
+class StateStream
+{
+public:
+	// Saving, appends to buffer
+	explicit StateStream(std::vector<uint8_t>& buffer) : out(&buffer) {}
+
+	// Loading, data must hold at least as many bytes as the save wrote
+	StateStream(const uint8_t* data, size_t size) : in(data), remaining(size) {}
+
+	bool isLoading() const { return in != nullptr; }
+
+	// False once a load ran past the end of its data
+	bool ok() const { return valid; }
+
+	// Whether the frame buffer is part of the state. Rewind snapshots
+	// leave it out, the next frame draws over it anyway
+	void setPicture(bool include) { picture = include; }
+	bool hasPicture() const { return picture; }
+
+	template<typename T>
+	void operator()(T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "serialize fields one by one");
+		bytes(&value, sizeof(T));
+	}
+
+	// Contents only, the size is fixed by the ROM and checked on load
+	void operator()(std::vector<uint8_t>& value)
+	{
+		bytes(value.data(), value.size());
+	}
+
+	// Loading only: the next size bytes of the state, in place, or null
+	// past the end. For fields that are compared before they are copied
+	const uint8_t* read(size_t size)
+	{
+		if (size > remaining)
+		{
+			valid = false;
+			return nullptr;
+		}
+		const uint8_t* data = in;
+		in += size;
+		remaining -= size;
+		return data;
+	}
+
+	void bytes(void* data, size_t size)
+	{
+		if (out)
+		{
+			const uint8_t* source = static_cast<const uint8_t*>(data);
+			out->insert(out->end(), source, source + size);
+		}
+		else if (size <= remaining)
+		{
+			std::memcpy(data, in, size);
+			in += size;
+			remaining -= size;
+		}
+		else
+		{
+			valid = false;
+		}
+	}
+
+private:
+	std::vector<uint8_t>* out = nullptr;
+	const uint8_t* in = nullptr;
+	size_t remaining = 0;
+	bool valid = true;
+	bool picture = true;
+};
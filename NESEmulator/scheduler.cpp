@@ -0,0 +1,113 @@
+#include "scheduler.h"
+
+Scheduler::Scheduler()
+{
+	clock = nullptr;
+	times.fill(Never);
+	heap.fill(0);
+	position.fill(NotQueued);
+	size = 0;
+	irqLines = 0;
+}
+
+void Scheduler::serialize(StateStream& state)
+{
+	state(times);
+	state(heap);
+	state(position);
+	state(size);
+	state(irqLines);
+}
+
+void Scheduler::setHandler(EventType type, std::function<void()> handler)
+{
+	handlers[index(type)] = std::move(handler);
+}
+
+void Scheduler::schedule(EventType type, uint64_t time)
+{
+	uint8_t id = static_cast<uint8_t>(index(type));
+	if (position[id] == NotQueued)
+	{
+		heap[size] = id;
+		position[id] = static_cast<uint8_t>(size);
+		size++;
+		times[id] = time;
+		siftUp(position[id]);
+	}
+	else
+	{
+		times[id] = time;
+		siftUp(position[id]);
+		siftDown(position[id]);
+	}
+}
+
+void Scheduler::cancel(EventType type)
+{
+	uint8_t id = static_cast<uint8_t>(index(type));
+	if (position[id] != NotQueued)
+		remove(position[id]);
+}
+
+void Scheduler::run()
+{
+	while (size > 0 && times[heap[0]] <= *clock)
+	{
+		uint8_t id = heap[0];
+		remove(0);
+		if (handlers[id])
+			handlers[id]();
+	}
+}
+
+void Scheduler::swap(int i, int j)
+{
+	std::swap(heap[i], heap[j]);
+	position[heap[i]] = static_cast<uint8_t>(i);
+	position[heap[j]] = static_cast<uint8_t>(j);
+}
+
+void Scheduler::siftUp(int i)
+{
+	while (i > 0)
+	{
+		int parent = (i - 1) / 2;
+		if (!before(heap[i], heap[parent]))
+			break;
+		swap(i, parent);
+		i = parent;
+	}
+}
+
+void Scheduler::siftDown(int i)
+{
+	while (true)
+	{
+		int first = i;
+		int left = i * 2 + 1;
+		int right = left + 1;
+		if (left < size && before(heap[left], heap[first]))
+			first = left;
+		if (right < size && before(heap[right], heap[first]))
+			first = right;
+		if (first == i)
+			break;
+		swap(i, first);
+		i = first;
+	}
+}
+
+void Scheduler::remove(int i)
+{
+	uint8_t id = heap[i];
+	size--;
+	if (i != size)
+	{
+		swap(i, size);
+		siftUp(i);
+		siftDown(i);
+	}
+	position[id] = NotQueued;
+	times[id] = Never;
+}
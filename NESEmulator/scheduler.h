@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <functional>
+#include <utility>
+#include "savestate.h"
+
+// Cycle-timestamped events, timed against the CPU cycle counter
+enum class EventType : uint8_t
+{
+	PPUSync,          // PPU reaches vblank or the end of the frame
+	NMI,
+	DMA,              // OAM DMA requested through $4014
+	APUFrameCounter,
+	MapperIRQ,        // For mappers whose IRQ counts CPU cycles
+	DMCIRQ,           // DMC fetches the last byte of a sample
+	Count
+};
+
+// Sources that can hold the CPU's IRQ line low
+enum class IRQSource : uint8_t
+{
+	APUFrame = 0x01,
+	Mapper   = 0x02,
+	DMC      = 0x04
+};
+
+// At most one pending event per type, kept in a small binary heap so the
+// CPU only compares against the earliest one between instructions
+class Scheduler
+{
+public:
+	static constexpr int EventCount = static_cast<int>(EventType::Count);
+	static constexpr uint64_t Never = UINT64_MAX;
+
+	Scheduler();
+
+	void setClock(const uint64_t* clock) { this->clock = clock; }
+	uint64_t now() const { return *clock; }
+
+	void setHandler(EventType type, std::function<void()> handler);
+
+	// Replaces any pending event of the same type
+	void schedule(EventType type, uint64_t time);
+	void cancel(EventType type);
+	bool isScheduled(EventType type) const { return position[index(type)] != NotQueued; }
+
+	uint64_t nextEvent() const { return size > 0 ? times[heap[0]] : Never; }
+
+	// Runs every event that is due by the current clock, including ones
+	// that handlers schedule along the way
+	void run();
+
+	void raiseIRQ(IRQSource source) { irqLines |= static_cast<uint8_t>(source); }
+	void clearIRQ(IRQSource source) { irqLines &= ~static_cast<uint8_t>(source); }
+	bool irqAsserted() const { return irqLines != 0; }
+
+	// Pending events and IRQ lines; the handlers stay bound
+	void serialize(StateStream& state);
+
+private:
+	static constexpr uint8_t NotQueued = 0xFF;
+
+	const uint64_t* clock;
+	std::array<std::function<void()>, EventCount> handlers;
+	std::array<uint64_t, EventCount> times;
+	std::array<uint8_t, EventCount> heap;      // Event types, earliest first
+	std::array<uint8_t, EventCount> position;  // Heap slot of each type
+	int size;
+	uint8_t irqLines;
+
+	static int index(EventType type) { return static_cast<int>(type); }
+
+	// Ties go to the lower event type so ordering is deterministic
+	bool before(uint8_t a, uint8_t b) const { return times[a] < times[b] || (times[a] == times[b] && a < b); }
+	void swap(int i, int j);
+	void siftUp(int i);
+	void siftDown(int i);
+	void remove(int i);
+};
@@ -0,0 +1,108 @@
+#include "trace.h"
+#include "cpu.h"
+#include <cstdio>
+#include <fstream>
+
+TraceBuffer::TraceBuffer(size_t capacity)
+{
+	size_t size = 1;
+	while (size < capacity)
+	{
+		size <<= 1;
+	}
+	records.resize(size);
+	head = 0;
+	mask = size - 1;
+}
+
+void TraceBuffer::dump(std::ostream& out) const
+{
+	for (size_t i = 0; i < size(); ++i)
+	{
+		out << format((*this)[i]) << '\n';
+	}
+}
+
+std::string TraceBuffer::format(const TraceRecord& rec)
+{
+	using M = CPU::AddressingMode;
+
+	uint8_t op = rec.bytes[0];
+	uint8_t length = CPU::getOpLength(op);
+	uint8_t lo = rec.bytes[1];
+	uint16_t abs = lo | (rec.bytes[2] << 8);
+
+	char bytes[16];
+	switch (length)
+	{
+		case 1: snprintf(bytes, sizeof(bytes), "%02X", op); break;
+		case 2: snprintf(bytes, sizeof(bytes), "%02X %02X", op, lo); break;
+		default: snprintf(bytes, sizeof(bytes), "%02X %02X %02X", op, lo, rec.bytes[2]); break;
+	}
+
+	char operand[16] = "";
+	switch (CPU::getAddressingMode(op))
+	{
+		case M::Accumulator: snprintf(operand, sizeof(operand), "A"); break;
+		case M::Immediate:   snprintf(operand, sizeof(operand), "#$%02X", lo); break;
+		case M::Relative:    snprintf(operand, sizeof(operand), "$%04X", (rec.pc + 2 + static_cast<int8_t>(lo)) & 0xFFFF); break;
+		case M::ZeroPage:    snprintf(operand, sizeof(operand), "$%02X", lo); break;
+		case M::ZeroPageX:   snprintf(operand, sizeof(operand), "$%02X,X", lo); break;
+		case M::ZeroPageY:   snprintf(operand, sizeof(operand), "$%02X,Y", lo); break;
+		case M::Absolute:    snprintf(operand, sizeof(operand), "$%04X", abs); break;
+		case M::AbsoluteX:   snprintf(operand, sizeof(operand), "$%04X,X", abs); break;
+		case M::AbsoluteY:   snprintf(operand, sizeof(operand), "$%04X,Y", abs); break;
+		case M::Indirect:    snprintf(operand, sizeof(operand), "($%04X)", abs); break;
+		case M::IndirectX:   snprintf(operand, sizeof(operand), "($%02X,X)", lo); break;
+		case M::IndirectY:   snprintf(operand, sizeof(operand), "($%02X),Y", lo); break;
+		default: break;
+	}
+
+	// Unofficial opcodes carry a leading '*' in the column before the mnemonic
+	std::string_view name = CPU::getOpName(op);
+	char mnemonic[48];
+	snprintf(mnemonic, sizeof(mnemonic), "%s%.*s %s",
+		name[0] == '*' ? "" : " ", static_cast<int>(name.size()), name.data(), operand);
+
+	char line[128];
+	snprintf(line, sizeof(line), "%04X  %-9s%-33sA:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3u,%3u CYC:%llu",
+		rec.pc, bytes, mnemonic, rec.a, rec.x, rec.y, rec.p, rec.sp,
+		rec.scanline, rec.dot, static_cast<unsigned long long>(rec.cycles));
+	return line;
+}
+
+bool TraceBuffer::save(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	uint64_t count = size();
+	file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+	for (size_t i = 0; i < count; ++i)
+	{
+		file.write(reinterpret_cast<const char*>(&(*this)[i]), sizeof(TraceRecord));
+	}
+	return file.good();
+}
+
+bool TraceBuffer::load(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	uint64_t count = 0;
+	if (!file.read(reinterpret_cast<char*>(&count), sizeof(count)))
+	{
+		return false;
+	}
+
+	// Keep the newest records if the file holds more than we can
+	clear();
+	TraceRecord rec;
+	while (count-- > 0 && file.read(reinterpret_cast<char*>(&rec), sizeof(rec)))
+	{
+		record() = rec;
+	}
+	return true;
+}
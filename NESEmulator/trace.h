@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// One executed instruction, captured before it runs
+struct TraceRecord
+{
+	uint64_t cycles;    // CPU cycle count
+	uint16_t pc;
+	uint8_t bytes[3];   // Opcode followed by up to two operand bytes
+	uint8_t a, x, y, p, sp;
+	uint16_t scanline;
+	uint16_t dot;
+};
+
+// Fixed-size ring of binary trace records. Storage is allocated once and
+// recording never formats anything; text is only produced by dump()
+class TraceBuffer
+{
+public:
+	// Capacity is rounded up to a power of two
+	explicit TraceBuffer(size_t capacity = 1 << 20);
+
+	TraceRecord& record()
+	{
+		return records[head++ & mask];
+	}
+
+	size_t size() const { return head < records.size() ? static_cast<size_t>(head) : records.size(); }
+	size_t capacity() const { return records.size(); }
+	void clear() { head = 0; }
+
+	// Oldest record first
+	const TraceRecord& operator[](size_t i) const
+	{
+		return records[(head - size() + i) & mask];
+	}
+
+	// Nestest-style text, one line per record
+	void dump(std::ostream& out) const;
+	static std::string format(const TraceRecord& rec);
+
+	// Raw records for formatting offline with load() + dump()
+	bool save(const std::string& path) const;
+	bool load(const std::string& path);
+
+private:
+	std::vector<TraceRecord> records;
+	uint64_t head;
+	uint64_t mask;
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free triple buffer for one producer and one consumer thread. The
+// producer always has a free slot to write into and the consumer always
+// gets the most recently published one. Frames the consumer misses are
+// dropped, so neither side ever waits on the other
+template<typename T>
+class TripleBuffer
+{
+public:
+	// Slot the producer is filling
+	T& back() { return slots[backIndex]; }
+
+	// Hands the back slot to the consumer and takes the spare one in return
+	void publish()
+	{
+		backIndex = middle.exchange(backIndex | FreshBit, std::memory_order_acq_rel) & IndexMask;
+	}
+
+	// Swaps in the newest published slot. Returns false if nothing was
+	// published since the last call
+	bool update()
+	{
+		if (!(middle.load(std::memory_order_relaxed) & FreshBit))
+			return false;
+		frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & IndexMask;
+		return true;
+	}
+
+	// Slot the consumer is reading
+	const T& front() const { return slots[frontIndex]; }
+
+private:
+	static constexpr uint8_t IndexMask = 0x03;
+	static constexpr uint8_t FreshBit = 0x04;
+
+	std::array<T, 3> slots{};
+	uint8_t backIndex = 0;
+	std::atomic<uint8_t> middle{ 1 }; // Spare slot, FreshBit once published
+	uint8_t frontIndex = 2;
+};
@@ -0,0 +1,589 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <chrono>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "emulator.h"
+#include "palette.h"
+#include "movie.h"
+#include "job_pool.h"
+#include "selftest.h"
+
+// Windowless runner: runs every ROM/input script combination for a fixed
+// number of frames as fast as the core allows, one Emulator per job
+// spread over a pool of worker threads, and writes what the output spec
+// asks for once each job's last frame is done
+
+// Buttons held on both ports from frame on, until the next entry
+struct InputEntry
+{
+	uint64_t frame;
+	uint8_t buttons[2];
+};
+
+// A script, or a movie when isMovie is set
+struct InputScript
+{
+	std::string path; // Empty when running without input
+	std::vector<InputEntry> entries;
+	bool isMovie = false;
+	Movie movie;
+};
+
+// What to write after each job. Paths may contain {rom} and {input},
+// replaced by the file names of the job's ROM and script without extension
+struct OutputSpec
+{
+	std::string ramPath;   // CPU RAM, 2 KB raw
+	std::string framePath; // Last frame as a binary PPM
+	std::string moviePath; // The job's input, recorded as a movie
+	std::string hashPath;  // Frame and RAM hash of every frame, one per line
+	std::string goldenPath; // Hash list from --verify the run must match
+};
+
+struct Job
+{
+	std::string romPath;
+	const InputScript* script;
+};
+
+// Filled in by the worker that ran the job, read once the pool is done
+struct JobResult
+{
+	bool ok = false;
+	std::string error;
+	int frames = 0;
+	uint64_t instructions = 0;
+	double seconds = 0;
+};
+
+static void printUsage()
+{
+	std::cout <<
+		"Usage: NESHeadless <rom>... [options]\n"
+		"  --frames <n>       Frames to run each ROM for (default 600)\n"
+		"  --input <script>   Controller input, one '<frame> <pad1> [<pad2>]' per line.\n"
+		"                     Pads use FM2 columns RLDUTSBA, '.' for released.\n"
+		"                     May be repeated, every ROM runs with every script\n"
+		"  --movie <file>     Replay a recorded movie for its whole length instead of\n"
+		"                     --frames. May be repeated and mixed with --input\n"
+		"  --output <spec>    Comma-separated ram=<path>, frame=<path>, movie=<path>\n"
+		"                     (records the job's input) and/or hashes=<path> (frame\n"
+		"                     and RAM hash of every frame), {rom} and {input} in a\n"
+		"                     path are replaced by the job's names\n"
+		"  --verify <path>    Fail jobs whose hashes differ from this hashes= list,\n"
+		"                     {rom} and {input} are replaced as in --output\n"
+		"  --jobs <n>         Worker threads (default: one per core)\n"
+		"  --report <path>    Write per-job results as JSON\n"
+		"  --scaling          Run everything at 1, 2, 4... workers up to --jobs\n"
+		"                     and report throughput instead of writing output\n"
+		"  --scanline         Use the scanline renderer\n"
+		"  --selftest         Check the SSE2 compositor against the scalar one, then\n"
+		"                     run each ROM for --frames in dot mode, composing each\n"
+		"                     drawn line again to compare. ROMs are optional\n";
+}
+
+static bool parseButtons(const std::string& text, uint8_t& buttons)
+{
+	static const char columns[] = "RLDUTSBA";
+	static const uint8_t bits[] = {
+		ButtonRight, ButtonLeft, ButtonDown, ButtonUp,
+		ButtonStart, ButtonSelect, ButtonB, ButtonA
+	};
+
+	if (text.size() != 8)
+		return false;
+
+	buttons = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		if (text[i] == columns[i])
+			buttons |= bits[i];
+		else if (text[i] != '.')
+			return false;
+	}
+	return true;
+}
+
+static bool loadInputScript(const std::string& path, InputScript& script)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cerr << "Failed to open input script " << path << "\n";
+		return false;
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream fields(line);
+		std::string pad1, pad2;
+		InputEntry entry = {};
+		if (!(fields >> entry.frame))
+			continue; // Blank or comment
+
+		bool valid = (fields >> pad1) && parseButtons(pad1, entry.buttons[0]);
+		if (valid && (fields >> pad2))
+			valid = parseButtons(pad2, entry.buttons[1]);
+		if (valid && !script.entries.empty() && entry.frame <= script.entries.back().frame)
+			valid = false;
+
+		if (!valid)
+		{
+			std::cerr << path << ":" << lineNumber << ": bad input line\n";
+			return false;
+		}
+		script.entries.push_back(entry);
+	}
+	script.path = path;
+	return true;
+}
+
+static bool parseOutputSpec(const std::string& spec, OutputSpec& output)
+{
+	std::istringstream items(spec);
+	std::string item;
+	while (std::getline(items, item, ','))
+	{
+		size_t split = item.find('=');
+		std::string kind = item.substr(0, split);
+		std::string path = split == std::string::npos ? "" : item.substr(split + 1);
+
+		if (path.empty())
+			return false;
+		if (kind == "ram")
+			output.ramPath = path;
+		else if (kind == "frame")
+			output.framePath = path;
+		else if (kind == "movie")
+			output.moviePath = path;
+		else if (kind == "hashes")
+			output.hashPath = path;
+		else
+			return false;
+	}
+	return true;
+}
+
+static void replaceAll(std::string& text, const std::string& from, const std::string& to)
+{
+	for (size_t pos = 0; (pos = text.find(from, pos)) != std::string::npos; pos += to.size())
+		text.replace(pos, from.size(), to);
+}
+
+static std::string expandPath(std::string path, const Job& job)
+{
+	replaceAll(path, "{rom}", std::filesystem::path(job.romPath).stem().string());
+	replaceAll(path, "{input}", std::filesystem::path(job.script->path).stem().string());
+	return path;
+}
+
+static bool writeFrame(const std::string& path, Emulator& emulator)
+{
+	std::vector<uint32_t> rgba(256 * 240);
+	convertFrame(emulator.getPPU().getFrameBuffer(), emulator.getPPU().getLineEmphasis(), rgba.data());
+
+	std::vector<char> rgb(rgba.size() * 3);
+	for (size_t i = 0; i < rgba.size(); i++)
+	{
+		rgb[i * 3 + 0] = static_cast<char>(rgba[i] >> 24);
+		rgb[i * 3 + 1] = static_cast<char>(rgba[i] >> 16);
+		rgb[i * 3 + 2] = static_cast<char>(rgba[i] >> 8);
+	}
+
+	std::ofstream file(path, std::ios::binary);
+	file << "P6\n256 240\n255\n";
+	file.write(rgb.data(), rgb.size());
+	return static_cast<bool>(file);
+}
+
+// '<frame> <video hash> <RAM hash>', hashes in hex
+static bool writeHashes(const std::string& path, const std::vector<Emulator::FrameHash>& hashes)
+{
+	std::ofstream file(path);
+	file << std::hex << std::setfill('0');
+	for (const Emulator::FrameHash& hash : hashes)
+	{
+		file << std::dec << hash.frame << std::hex
+			<< " " << std::setw(16) << hash.video
+			<< " " << std::setw(16) << hash.ram << "\n";
+	}
+	return static_cast<bool>(file);
+}
+
+// Every frame in the golden list must have run and match, frames the
+// list leaves out aren't checked. Returns an empty string on success
+static std::string verifyHashes(const std::string& path, const std::vector<Emulator::FrameHash>& hashes)
+{
+	std::ifstream file(path);
+	if (!file)
+		return "failed to open " + path;
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream fields(line);
+		Emulator::FrameHash golden;
+		if (!(fields >> std::dec >> golden.frame))
+			continue; // Blank line
+		if (!(fields >> std::hex >> golden.video >> golden.ram))
+			return "bad line in " + path;
+
+		if (hashes.empty() || golden.frame < hashes.front().frame || golden.frame > hashes.back().frame)
+			return "frame " + std::to_string(golden.frame) + " didn't run";
+
+		const Emulator::FrameHash& hash = hashes[golden.frame - hashes.front().frame];
+		if (hash.video != golden.video)
+			return "frame " + std::to_string(golden.frame) + " picture differs from " + path;
+		if (hash.ram != golden.ram)
+			return "frame " + std::to_string(golden.frame) + " RAM differs from " + path;
+	}
+	return "";
+}
+
+static bool writeRAM(const std::string& path, Emulator& emulator)
+{
+	std::ofstream file(path, std::ios::binary);
+	file.write(reinterpret_cast<const char*>(emulator.getMemory().getRAM()), 2048);
+	return static_cast<bool>(file);
+}
+
+// Everything a job touches lives in its own Emulator, so any number of
+// these can run at once
+static JobResult runJob(const Job& job, int frames, const OutputSpec* output, NEW_PPU::RenderMode renderMode)
+{
+	JobResult result;
+	Emulator emulator;
+	if (!emulator.loadROM(job.romPath))
+	{
+		result.error = "ROM not loaded";
+		return result;
+	}
+	emulator.getPPU().setRenderMode(renderMode);
+
+	const Movie* movie = job.script->isMovie ? &job.script->movie : nullptr;
+	if (movie)
+	{
+		if (!movie->start(emulator))
+		{
+			result.error = "movie doesn't match the ROM";
+			return result;
+		}
+		frames = static_cast<int>(movie->getFrameCount());
+	}
+
+	Movie recording;
+	bool record = output && !output->moviePath.empty();
+	if (record)
+		recording.startRecording(emulator);
+
+	std::vector<Emulator::FrameHash> hashes;
+	bool hashing = output && (!output->hashPath.empty() || !output->goldenPath.empty());
+	if (hashing)
+	{
+		emulator.setFrameHashing(true);
+		hashes.reserve(frames);
+	}
+
+	const std::vector<InputEntry>& script = job.script->entries;
+	size_t nextInput = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		// Input is only sampled between frames
+		if (movie)
+			movie->apply(emulator, frame);
+		while (nextInput < script.size() && script[nextInput].frame <= static_cast<uint64_t>(frame))
+		{
+			emulator.getController(0).setButtons(script[nextInput].buttons[0]);
+			emulator.getController(1).setButtons(script[nextInput].buttons[1]);
+			nextInput++;
+		}
+		if (record)
+			recording.record(emulator.getController(0).getButtons(), emulator.getController(1).getButtons());
+
+		emulator.runFrame();
+		if (hashing)
+			hashes.push_back(emulator.getFrameHash());
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	result.frames = frames;
+	result.instructions = emulator.getInstructionCount();
+	result.seconds = elapsed.count();
+
+	bool written = true;
+	if (record)
+		written &= recording.save(expandPath(output->moviePath, job));
+	if (output && !output->hashPath.empty())
+		written &= writeHashes(expandPath(output->hashPath, job), hashes);
+	if (output && !output->ramPath.empty())
+		written &= writeRAM(expandPath(output->ramPath, job), emulator);
+	if (output && !output->framePath.empty())
+		written &= writeFrame(expandPath(output->framePath, job), emulator);
+	if (!written)
+	{
+		result.error = "failed to write output";
+		return result;
+	}
+
+	if (output && !output->goldenPath.empty())
+	{
+		result.error = verifyHashes(expandPath(output->goldenPath, job), hashes);
+		if (!result.error.empty())
+			return result;
+	}
+
+	result.ok = true;
+	return result;
+}
+
+static std::string jsonString(const std::string& text)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	std::string quoted = "\"";
+	for (char c : text)
+	{
+		if (static_cast<unsigned char>(c) < 0x20)
+		{
+			// Control characters can't appear raw in a JSON string
+			quoted += "\\u00";
+			quoted += hex[c >> 4];
+			quoted += hex[c & 0x0F];
+			continue;
+		}
+		if (c == '"' || c == '\\')
+			quoted += '\\';
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+// Whole argument as a number above zero
+static bool parseCount(const char* text, int& value)
+{
+	const char* end = text + std::strlen(text);
+	auto [last, error] = std::from_chars(text, end, value);
+	return error == std::errc() && last == end && value > 0;
+}
+
+static bool writeReport(const std::string& path, const std::vector<Job>& jobs, const std::vector<JobResult>& results,
+	int frames, int workers, double seconds)
+{
+	std::ofstream file(path);
+	file << "{\n";
+	file << "  \"frames\": " << frames << ",\n";
+	file << "  \"workers\": " << workers << ",\n";
+	file << "  \"seconds\": " << seconds << ",\n";
+	file << "  \"jobs\": [\n";
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		const JobResult& result = results[i];
+		file << "    { \"rom\": " << jsonString(jobs[i].romPath)
+			<< ", \"input\": " << jsonString(jobs[i].script->path)
+			<< ", \"ok\": " << (result.ok ? "true" : "false")
+			<< ", \"error\": " << jsonString(result.error)
+			<< ", \"frames\": " << result.frames
+			<< ", \"instructions\": " << result.instructions
+			<< ", \"seconds\": " << result.seconds << " }"
+			<< (i + 1 < jobs.size() ? ",\n" : "\n");
+	}
+	file << "  ]\n";
+	file << "}\n";
+	return static_cast<bool>(file);
+}
+
+// Runs every job at 1, 2, 4... workers and reports how throughput grows.
+// Jobs are independent, so it should stay close to linear up to the
+// number of physical cores
+static void runScaling(const std::vector<Job>& jobs, int frames, int maxWorkers, NEW_PPU::RenderMode renderMode)
+{
+	std::vector<int> counts;
+	for (int workers = 1; workers < maxWorkers; workers *= 2)
+		counts.push_back(workers);
+	counts.push_back(maxWorkers);
+
+	double baseline = 0;
+	for (int workers : counts)
+	{
+		// Movies run for their own length, so count what actually ran
+		std::vector<JobResult> results(jobs.size());
+		auto start = std::chrono::steady_clock::now();
+		runJobs(jobs.size(), workers, [&](size_t i) { results[i] = runJob(jobs[i], frames, nullptr, renderMode); });
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		uint64_t totalFrames = 0;
+		for (const JobResult& result : results)
+			totalFrames += result.frames;
+		double fps = totalFrames / elapsed.count();
+		if (workers == 1)
+			baseline = fps;
+		std::cout << "workers " << workers << ": " << fps << " frames/s, "
+			<< fps / baseline << "x\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> roms;
+	std::vector<InputScript> scripts;
+	OutputSpec output;
+	std::string reportPath;
+	int frames = 600;
+	int workers = std::max(1u, std::thread::hardware_concurrency());
+	bool scaling = false;
+	bool selfTest = false;
+	NEW_PPU::RenderMode renderMode = NEW_PPU::RenderMode::Dot;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--frames" && hasValue)
+		{
+			if (!parseCount(argv[++i], frames))
+			{
+				printUsage();
+				return 1;
+			}
+		}
+		else if (arg == "--input" && hasValue)
+		{
+			scripts.emplace_back();
+			if (!loadInputScript(argv[++i], scripts.back()))
+				return 1;
+		}
+		else if (arg == "--movie" && hasValue)
+		{
+			scripts.emplace_back();
+			scripts.back().path = argv[++i];
+			scripts.back().isMovie = true;
+			if (!scripts.back().movie.load(scripts.back().path))
+			{
+				std::cerr << "Failed to load movie " << scripts.back().path << "\n";
+				return 1;
+			}
+		}
+		else if (arg == "--output" && hasValue)
+		{
+			if (!parseOutputSpec(argv[++i], output))
+			{
+				std::cerr << "Bad output spec " << argv[i] << "\n";
+				return 1;
+			}
+		}
+		else if (arg == "--verify" && hasValue)
+		{
+			output.goldenPath = argv[++i];
+		}
+		else if (arg == "--jobs" && hasValue)
+		{
+			if (!parseCount(argv[++i], workers))
+			{
+				printUsage();
+				return 1;
+			}
+		}
+		else if (arg == "--report" && hasValue)
+		{
+			reportPath = argv[++i];
+		}
+		else if (arg == "--scaling")
+		{
+			scaling = true;
+		}
+		else if (arg == "--scanline")
+		{
+			renderMode = NEW_PPU::RenderMode::Scanline;
+		}
+		else if (arg == "--selftest")
+		{
+			selfTest = true;
+		}
+		else if (arg.rfind("--", 0) == 0)
+		{
+			printUsage();
+			return 1;
+		}
+		else
+		{
+			roms.push_back(arg);
+		}
+	}
+
+	if (selfTest)
+	{
+		return runSelfTest(roms, frames) ? 1 : 0;
+	}
+
+	if (roms.empty())
+	{
+		printUsage();
+		return 1;
+	}
+
+	if (scripts.empty())
+		scripts.emplace_back();
+
+	std::vector<Job> jobs;
+	for (const std::string& rom : roms)
+	{
+		for (const InputScript& script : scripts)
+			jobs.push_back({ rom, &script });
+	}
+
+	if (scaling)
+	{
+		runScaling(jobs, frames, workers, renderMode);
+		return 0;
+	}
+
+	std::vector<JobResult> results(jobs.size());
+	auto start = std::chrono::steady_clock::now();
+	runJobs(jobs.size(), workers, [&](size_t i) { results[i] = runJob(jobs[i], frames, &output, renderMode); });
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	int failures = 0;
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		const Job& job = jobs[i];
+		const JobResult& result = results[i];
+		std::cout << job.romPath;
+		if (!job.script->path.empty())
+			std::cout << " (" << job.script->path << ")";
+
+		if (result.ok)
+		{
+			std::cout << ": " << result.frames << " frames, "
+				<< result.instructions << " instructions, "
+				<< result.seconds << " s, "
+				<< result.frames / result.seconds << " fps\n";
+		}
+		else
+		{
+			std::cout << ": " << result.error << "\n";
+			failures++;
+		}
+	}
+	std::cout << jobs.size() << " jobs on " << workers << " workers in " << elapsed.count() << " s\n";
+
+	if (!reportPath.empty() && !writeReport(reportPath, jobs, results, frames, workers, elapsed.count()))
+	{
+		std::cerr << "Failed to write report " << reportPath << "\n";
+		failures++;
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,69 @@
+#include "job_pool.h"
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// Jobs take whole seconds, so a lock per queue costs nothing
+	struct WorkQueue
+	{
+		std::mutex lock;
+		std::deque<size_t> jobs;
+	};
+
+	bool popFront(WorkQueue& queue, size_t& job)
+	{
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (queue.jobs.empty())
+			return false;
+		job = queue.jobs.front();
+		queue.jobs.pop_front();
+		return true;
+	}
+
+	// Thieves take from the other end, away from the owner
+	bool popBack(WorkQueue& queue, size_t& job)
+	{
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (queue.jobs.empty())
+			return false;
+		job = queue.jobs.back();
+		queue.jobs.pop_back();
+		return true;
+	}
+}
+
+void runJobs(size_t count, int workers, const std::function<void(size_t)>& job)
+{
+	if (workers < 1)
+		workers = 1;
+
+	// No job is ever added once workers start, so an empty sweep over
+	// every queue means there is nothing left to do
+	std::vector<WorkQueue> queues(workers);
+	for (size_t i = 0; i < count; i++)
+		queues[i % workers].jobs.push_back(i);
+
+	auto work = [&](int self)
+	{
+		size_t next;
+		while (true)
+		{
+			bool found = popFront(queues[self], next);
+			for (int i = 1; !found && i < workers; i++)
+				found = popBack(queues[(self + i) % workers], next);
+			if (!found)
+				return;
+			job(next);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < workers; i++)
+		threads.emplace_back(work, i);
+	work(0);
+	for (std::thread& thread : threads)
+		thread.join();
+}
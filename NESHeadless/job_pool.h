@@ -0,0 +1,9 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+
+// Runs job(0) .. job(count - 1) on the given number of worker threads and
+// returns once all of them are done. Jobs are dealt out round robin up
+// front; a worker whose own queue runs dry steals from the back of
+// another's, so a few long jobs don't leave the rest of the pool idle
+void runJobs(size_t count, int workers, const std::function<void(size_t)>& job);
@@ -0,0 +1,84 @@
+#include "selftest.h"
+#include <iostream>
+#include <algorithm>
+#include <array>
+#include <random>
+#include "emulator.h"
+#include "compositor.h"
+
+// Random lines in the form the scanline renderer gathers them: a quarter
+// of the background transparent, half the pixels without a sprite, and
+// the priority and sprite 0 flags set at random
+static int checkCompositor(int runs)
+{
+	std::mt19937 random(1);
+	auto next = [&](int limit) { return static_cast<int>(random() % limit); };
+
+	int failures = 0;
+	for (int run = 0; run < runs; run++)
+	{
+		std::array<uint8_t, 256> bg, sprite;
+		for (int x = 0; x < 256; x++)
+		{
+			bg[x] = next(4) ? static_cast<uint8_t>(next(4) << 2 | (1 + next(3))) : 0;
+			sprite[x] = next(2) ? static_cast<uint8_t>(0x10 | next(4) << 2 | (1 + next(3))) : 0;
+			if (next(4) == 0)
+				sprite[x] |= SpriteBehind;
+			if (next(16) == 0)
+				sprite[x] |= SpriteZero;
+		}
+
+		int start = next(257);
+		int end = start + next(257 - start);
+		uint8_t mask = static_cast<uint8_t>(next(256));
+
+		// Pixels outside the run have to come through untouched as well
+		std::array<uint8_t, 256> expected, actual;
+		expected.fill(0xAA);
+		actual.fill(0xAA);
+		bool expectedHit = composePixelsScalar(bg.data(), sprite.data(), expected.data(), start, end, mask);
+		bool actualHit = composePixels(bg.data(), sprite.data(), actual.data(), start, end, mask);
+
+		if (expected != actual || expectedHit != actualHit)
+		{
+			if (failures == 0)
+			{
+				std::cout << "compositor: run " << run << " (pixels " << start << "-" << end
+					<< ", mask " << static_cast<int>(mask) << ") differs from the scalar version\n";
+			}
+			failures++;
+		}
+	}
+
+	std::cout << "compositor: " << runs - failures << " of " << runs << " random runs match\n";
+	return failures ? 1 : 0;
+}
+
+// Runs the ROM in dot mode, where drawPixel() draws every pixel, and has
+// the PPU compose each finished line again through composePixels()
+static int checkDrawnFrames(const std::string& romPath, int frames)
+{
+	Emulator emulator;
+	if (!emulator.loadROM(romPath))
+	{
+		std::cout << romPath << ": ROM not loaded\n";
+		return 1;
+	}
+
+	NEW_PPU& ppu = emulator.getPPU();
+	ppu.setCompositorCheck(true);
+	for (int frame = 0; frame < frames; frame++)
+		emulator.runFrame();
+
+	std::cout << romPath << ": " << ppu.getCheckedLines() - ppu.getMismatchedLines() << " of "
+		<< ppu.getCheckedLines() << " drawn lines match the compositor\n";
+	return ppu.getMismatchedLines() ? 1 : 0;
+}
+
+int runSelfTest(const std::vector<std::string>& roms, int frames)
+{
+	int failures = checkCompositor(200000);
+	for (const std::string& rom : roms)
+		failures += checkDrawnFrames(rom, frames);
+	return failures;
+}
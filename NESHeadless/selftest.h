@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Checks that need no reference output, for --selftest. The SSE2
+// compositor is run against the scalar one on random lines, then each
+// ROM is run in dot mode with every drawn line composed again through
+// composePixels() and compared. Prints what it finds and returns the
+// number of failures
+int runSelfTest(const std::vector<std::string>& roms, int frames);